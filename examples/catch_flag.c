@@ -74,10 +74,9 @@ const char *color[] = {"?",      "BLACK", "BLUE",  "GREEN",
 int get_color_from_sensor() {
     int val = 0;
 
-    if (ev3_search_sensor(LEGO_EV3_COLOR, &sn_color, 0)) {
-        if (!get_sensor_value(0, sn_color, &val) || (val < 0) || (val >= COLOR_COUNT)) {
-            val = 0;
-        }
+    // sn_color is found once in main
+    if (!get_sensor_value(0, sn_color, &val) || (val < 0) || (val >= COLOR_COUNT)) {
+        val = 0;
     }
     printf("%s\n", color[val]);
     return val;
@@ -7,6 +7,8 @@
 #include "../include/ev3.h"
 #include "../include/ev3_sensor.h"
 #include "../include/ev3_tacho.h"
+#include "../src/ev3_attr.h"
+#include "../src/sensor_bin.h"
 
 #define Sleep(msec) usleep((msec) * 1000)
 #define PORT_A 65
@@ -61,17 +63,22 @@ int get_min_maxspeed(uint8_t sn_1, uint8_t sn_2, uint8_t sn_3) {
 }
 
 bool found_red(uint8_t sn) {
-    float red;
-    float green;
-    float blue;
-    if (!get_sensor_value0(sn, &red)) {
-        red = 1020;
-    }
-    if (!get_sensor_value1(sn, &green)) {
-        green = 1020;
+    float red = 1020;
+    float green = 1020;
+    float blue = 1020;
+    SENSOR_VALUES rgb;
+    static int rgb_sn = -1; // Sensor already in RGB-RAW mode
+    if (sn != rgb_sn) {     // COL-COLOR, the default, has a single value
+        if (!ev3_attr_write(EV3_ATTR_SENSOR, sn, EV3_ATTR_MODE, "RGB-RAW") ||
+            !sensor_bin_refresh(sn)) {
+            return false;
+        }
+        rgb_sn = sn;
     }
-    if (!get_sensor_value2(sn, &blue)) {
-        blue = 1020;
+    if (sensor_bin_read(sn, &rgb) >= 3) { // One read for the three values
+        red = rgb.value[0];
+        green = rgb.value[1];
+        blue = rgb.value[2];
     }
     if ((red > 10) && (red > green) && (red > blue)) {
         return true;
@@ -41,16 +41,19 @@ int main(void) {
             }
         }
     }
+    if (!ev3_search_sensor(LEGO_EV3_COLOR, &sn_color, 0)) {
+        printf("COLOR sensor not found\n");
+        ev3_uninit();
+        return (2);
+    }
+    printf("COLOR sensor is found, reading COLOR...\n");
     for (;;) {
-        if (ev3_search_sensor(LEGO_EV3_COLOR, &sn_color, 0)) {
-            printf("COLOR sensor is found, reading COLOR...\n");
-            if (!get_sensor_value(0, sn_color, &val) || (val < 0) ||
-                (val >= COLOR_COUNT)) {
-                val = 0;
-            }
-            printf("\r(%s) \n", color[val]);
-            fflush(stdout);
+        if (!get_sensor_value(0, sn_color, &val) || (val < 0) ||
+            (val >= COLOR_COUNT)) {
+            val = 0;
         }
+        printf("\r(%s) \n", color[val]);
+        fflush(stdout);
         Sleep(200);
     }
 
@@ -1,3 +1,4 @@
+#include <math.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdbool.h>
@@ -5,7 +6,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
 #include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
@@ -13,64 +13,177 @@
 #include "include/ev3.h"
 #include "include/ev3_sensor.h"
 #include "include/ev3_tacho.h"
+#include "src/clock.h"
+#include "src/drive.h"
+#include "src/ev3_attr.h"
+#include "src/heading_pid.h"
+#include "src/instr.h"
+#include "src/mission.h"
+#include "src/motor.h"
+#include "src/odometry.h"
+#include "src/params.h"
+#include "src/registry.h"
+#include "src/sensor_hub.h"
+#include "src/sonar_filter.h"
+#include "src/sprt.h"
+#include "src/telemetry.h"
+#include "src/tick.h"
+#include "src/turn_profile.h"
 
-#define Sleep(msec) usleep((msec) * 1000)
-#define PORT_A 65
-#define PORT_B 66
-#define PORT_C 67
-#define PORT_D 68
+#define Sleep(msec) clock_sleep_ms(msec)
 
-#define DEFAULT_TIME 50
-#define DISTANCE_STOP 50
+#define DEFAULT_TIME 50 // Wheels stop if not commanded again within it (ms)
+#define WHEEL_DIAMETER 56 // mm
+#define AXLE_WIDTH 120    // Between the wheels (mm)
+
+// Distances of the straight moves (mm)
+#define CATCH_ADVANCE 150   // Into the flag with the clamp open
+#define OBSTACLE_BACK 340   // Away from the opponent before bypassing it
+#define BYPASS_FORWARD 340  // Past the opponent, per second it was before
+#define RETURN_BACK 680     // Away from the opponent on the way back
+#define NO_FLAG_ADVANCE 170 // Toward the other side when the flag was missed
+#define WALL_BACK 85        // Away from a wall too close
+#define DRIVE_RAMP 300      // Ramps of the moves by position (ms)
+#define END_ROTATE 100      // Turn in the base once the flag is dropped (deg)
+
+// Steps of the catch of the flag
+#define CLAMP_TIME 2000       // Longest a move of the clamp takes (ms)
+
+// Waits of the return (ms)
+#define RETURN_STOP_TIME 1000 // Before giving up in front of something close
+#define DROP_OPEN_TIME 500    // Clamp opening before turning away from the flag
+#define DROP_LEAVE_TIME 1500  // Then until the clamp is open
+
+// Test on the reads of the color that see no color, once the clamp is closed
+#define FLAG_P_SEEN 0.95f  // Probability a read sees the flag when it is there
+#define FLAG_P_FALSE 0.05f // and when it is not
+#define FLAG_ALPHA 0.01f   // Probability to take the floor for the flag
+#define FLAG_BETA 0.01f    // and the flag for the floor
+#define FLAG_READS_MAX 10  // Not decided after them: no flag
+// Reads closer than this are about the same, the test counts one of them
+#define FLAG_MIN_GAP 150   // ms, 3 periods of the color sensor
+
+#define HEADING_LIMIT 1.0f // Largest correction of move_straight, of the speed
+#define GYRO_RATE_GAP 100  // Longest gap to difference the angle over (ms)
+
+// Profile of the turns in place of turn_to
+#define TURN_ACCEL 500.0f   // degrees / s^2
+#define TURN_MIN_RATE 15.0f // degrees / s
+#define TURN_SETTLE 500     // Time allowed after the end of the profile (ms)
+
+// Period of the control loop (ms) and if it should run in realtime
+#define CONTROL_PERIOD 10
+#ifndef CONTROL_REALTIME // The tools that run on the computer disable it
+#define CONTROL_REALTIME true
+#endif
+
+#ifndef PLAY_SOUND
+#define PLAY_SOUND true
+#endif
+
+// Time between two reads of each sensor by the sensor thread (ms)
+#define SONAR_PERIOD 20
+#define GYRO_PERIOD 10
+#define COLOR_PERIOD 50
+#define WHEEL_PERIOD 20
+
+#define GYRO_CALIBRATION 2000 // Time to measure the bias of the gyro (ms)
+#define DEVICE_SEARCH_PERIOD 500 // Between two searches of a device gone (ms)
+
+// Log of every tick, about 5 minutes at 100 Hz
+#define TELEMETRY_FILE "telemetry.bin"
+#define TELEMETRY_BLOCKS 512
+
+// For the brick, the devices are found by their role in the registry
+enum {
+    ROLE_SONAR,
+    ROLE_GYRO,
+    ROLE_COLOR,
+    ROLE_WHEEL_LEFT,
+    ROLE_WHEEL_RIGHT,
+    ROLE_CLAMP,
+
+    ROLE_COUNT
+};
+
+const REGISTRY_ROLE roles[ROLE_COUNT] = {
+    [ROLE_SONAR] = {"the sonar", EV3_ATTR_SENSOR, EV3_ATTR_DRIVER_NAME,
+                    "lego-ev3-us"},
+    [ROLE_GYRO] = {"the gyroscope", EV3_ATTR_SENSOR, EV3_ATTR_DRIVER_NAME,
+                   "lego-ev3-gyro"},
+    [ROLE_COLOR] = {"the color sensor", EV3_ATTR_SENSOR, EV3_ATTR_DRIVER_NAME,
+                    "lego-ev3-color"},
+    [ROLE_WHEEL_LEFT] = {"the left wheel", EV3_ATTR_TACHO, EV3_ATTR_ADDRESS,
+                         "ev3-ports:outA"},
+    [ROLE_WHEEL_RIGHT] = {"the right wheel", EV3_ATTR_TACHO, EV3_ATTR_ADDRESS,
+                          "ev3-ports:outB"},
+    [ROLE_CLAMP] = {"the clamp", EV3_ATTR_TACHO, EV3_ATTR_ADDRESS,
+                    "ev3-ports:outC"},
+};
 
-// For the brick
-const int port_wheel_left = PORT_A;
-const int port_wheel_right = PORT_B;
-const int port_clamp = PORT_C;
 uint8_t sn_sonar;
 uint8_t sn_wheel_left;
 uint8_t sn_wheel_right;
 uint8_t sn_clamp;
 uint8_t sn_color;
 uint8_t sn_gyro;
+uint8_t *const sn_role[ROLE_COUNT] = {
+    [ROLE_SONAR] = &sn_sonar,
+    [ROLE_GYRO] = &sn_gyro,
+    [ROLE_COLOR] = &sn_color,
+    [ROLE_WHEEL_LEFT] = &sn_wheel_left,
+    [ROLE_WHEEL_RIGHT] = &sn_wheel_right,
+    [ROLE_CLAMP] = &sn_clamp,
+};
+DEVICE_HANDLE device[ROLE_COUNT]; // Checked at every tick, see check_devices
 
 // Variables that change over the course of the program
 int action = 0;
-float previous_sonar = -1;
 float val_sonar = -1;
+SONAR_FILTER sonar_filter; // All zero: no sample yet
+HEADING_PID heading_pid;   // Of move_straight
+float heading_target;      // Reference heading_pid was started for
+uint32_t sonar_count = 0; // Number of the last sonar sample used
+float sonar_filtered = -1; // Last value returned by update_sonar
+int clamp_state = TELEMETRY_CLAMP_STOPPED;
+int clamp_speed = 0;
+uint32_t tick_count = 0;
 int gyro_now = -1;
-long long start_4;
+float gyro_last_angle;       // Sample the rate was last differenced from
+long long gyro_last_us = -1; // and its time
+float gyro_last_rate = 0;
+double distance_4; // Odometry distance at the start of phase 4
+long long move_limit = 0; // Of the move by position, see move_done (ms)
+double mm_per_count; // Distance travelled per count of a wheel
 pid_t sound_pid;
 int step = 0;
 
 /**
- * @brief Shamelessly taken from https://stackoverflow.com/a/44896326
+ * @brief Get the time, only the difference between two calls has a meaning
+ * It is the time of the tick (see tick_time_us), the same during the tick.
  *
  * @return long long the current time in milliseconds
  */
-long long timeInMilliseconds(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (((long long)tv.tv_sec) * 1000) + (tv.tv_usec / 1000);
-}
+long long timeInMilliseconds(void) { return tick_time_us() / 1000; }
 
 /**
- * @brief Return the value of the sonar after some filtering, if the value is
- * set to -1, return the previous value
+ * @brief Return the value of the sonar after some filtering
+ * val_sonar is set to the last sample, the value returned is the distance the
+ * Kalman filter expects now, without the spikes of the sensor.
  *
  * @return float the value of the sonar
  */
 float update_sonar(void) {
-    get_sensor_value0(sn_sonar, &val_sonar);
-    if (previous_sonar == -1) {
-        previous_sonar = val_sonar;
+    HUB_SAMPLE sample;
+    if (sensor_hub_latest(HUB_SONAR, &sample) &&
+        (sample.count != sonar_count)) { // New sample since the last call
+        sonar_count = sample.count;
+        val_sonar = sample.values.value[0];
+        sonar_filter_update(&sonar_filter, val_sonar, sample.time_us);
     }
-    // if (previous_sonar > val_sonar + 100) {
-    //     return previous_sonar;
-    // }
-    float new_val = (val_sonar + previous_sonar) / 2; // To avoid interferences
-    previous_sonar = val_sonar;
-    return new_val;
+    float distance = sonar_filter_predict(&sonar_filter, tick_time_us());
+    sonar_filtered = (distance < 0) ? val_sonar : distance;
+    return sonar_filtered;
 }
 
 /**
@@ -79,11 +192,39 @@ float update_sonar(void) {
  * @return float gyro_now
  */
 int update_gyro() {
-    get_sensor_value(0, sn_gyro, &gyro_now);
+    HUB_SAMPLE sample;
+    if (sensor_hub_latest(HUB_GYRO, &sample)) {
+        gyro_now = (int)sample.values.value[0]; // GYRO-G&A: angle, rate
+    }
     // gyro_now = (int) gyro_now % 360;
     return gyro_now;
 }
 
+/**
+ * @brief Get the rate of the gyro from one of its samples
+ * Without the rate in the sample (GYRO-ANG instead of GYRO-G&A), it is the
+ * difference of the angle with the previous sample, 0 after a long gap.
+ *
+ * @param sample the sample
+ * @return float the rate (degrees / s)
+ */
+float gyro_rate(const HUB_SAMPLE *sample) {
+    if (sample->values.count >= 2) {
+        return sample->values.value[1];
+    }
+    if (sample->time_us != gyro_last_us) { // New sample
+        long long dt = sample->time_us - gyro_last_us;
+        gyro_last_rate = ((gyro_last_us >= 0) && (dt > 0) &&
+                          (dt <= GYRO_RATE_GAP * 1000LL))
+                             ? (sample->values.value[0] - gyro_last_angle) *
+                                   1e6f / dt
+                             : 0;
+        gyro_last_angle = sample->values.value[0];
+        gyro_last_us = sample->time_us;
+    }
+    return gyro_last_rate;
+}
+
 const char *color[] = {"?",      "BLACK", "BLUE",  "GREEN",
                        "YELLOW", "RED",   "WHITE", "BROWN"};
 
@@ -91,49 +232,35 @@ const char *color[] = {"?",      "BLACK", "BLUE",  "GREEN",
     ((int)(sizeof(color) / sizeof(color[0]))) // Number of colors in the array
 
 /**
- * @brief Retrieves the color from a sensor.
- *
- * This function checks if a LEGO EV3 color sensor is connected. If it is, it
- * retrieves the sensor value. If the sensor value is not retrievable, or if it
- * is outside the valid range (0 to COLOR_COUNT-1), it defaults to 0. It then
- * returns the color corresponding to the sensor value from the color array. If
- * the sensor is not connected, it returns the first color in the color array.
+ * @brief Get the index of a color from a value of the sensor
  *
- * @return const char* The color corresponding to the sensor value, or the first
- * color in the array if the sensor is not connected or the sensor value is
- * invalid.
+ * @param value the value, in COL-COLOR mode
+ * @return int The index of the color in the color array, 0 if the value is
+ * outside the valid range (0 to COLOR_COUNT-1).
  */
-int get_color_from_sensor(void) {
-    int val = 0;
-    if (ev3_search_sensor(LEGO_EV3_COLOR, &sn_color, 0)) {
-        if (!get_sensor_value(0, sn_color, &val) || (val < 0) ||
-            (val >= COLOR_COUNT)) {
-            val = 0;
-        }
+int color_index(float value) {
+    int val = (int)value;
+    if ((val < 0) || (val >= COLOR_COUNT)) {
+        val = 0;
     }
     return val;
 }
 
 /**
- * @brief Increment the action counter by 1
- * action is a global variable
+ * @brief Retrieves the color from a sensor.
  *
- */
-void change_action(void) {
-    action++; // Increment the action counter
-    printf("Action %d\n", action);
-    printf("%ld\n", time(NULL));
-}
-
-/**
- * @brief Force the action counter to be this value
- * action is a global variable
+ * This function retrieves the last value of the color sensor. If the sensor
+ * was never read, or if the value is invalid, it defaults to 0.
  *
- * @param new_action the new value for the action counter
+ * @return int The index of the color in the color array, 0 if the sensor
+ * value is invalid.
  */
-void override_action(int new_action) {
-    printf("Force the change of action from %d to %d\n", action, new_action);
-    action = new_action; // Force the action counter to be this value
+int get_color_from_sensor(void) {
+    HUB_SAMPLE sample;
+    if (!sensor_hub_latest(HUB_COLOR, &sample)) {
+        return 0;
+    }
+    return color_index(sample.values.value[0]);
 }
 
 /**
@@ -151,27 +278,6 @@ int MIN(int a, int b) {
     }
 }
 
-/**
- * @brief Test for the presence of a motor on the specified port
- *
- * @param port the port the motor should connected to
- * @param sn the address of the sn
- * @param text_yes the text to print when the motor is found
- * @param text_no the text to print when the motor is not found
- * @return bool if the motor was found or not
- */
-bool is_motor_here(int port, uint8_t *sn, char *text_yes, char *text_no) {
-    bool status = true;
-    if (!ev3_search_tacho_plugged_in(port, 0, sn,
-                                     0)) { // Check if the motor is connected
-        printf("%s\n", text_no);
-        status = false;
-    } else {
-        printf("%s\n", text_yes);
-    }
-    return status;
-}
-
 /**
  * @brief Get the minimum of the maximum speed the motors can run at
  *
@@ -183,16 +289,17 @@ bool is_motor_here(int port, uint8_t *sn, char *text_yes, char *text_no) {
 int get_min_maxspeed(uint8_t sn_1, uint8_t sn_2, uint8_t sn_3) {
     int max_speed;
     int temp;
-    if (get_tacho_max_speed(sn_1, &max_speed) == 0) {
+    if (!ev3_attr_read_int(EV3_ATTR_TACHO, sn_1, EV3_ATTR_MAX_SPEED,
+                           &max_speed)) {
         printf("Could not read the maximum speed for first arg\n");
         max_speed = -1;
     }
-    if (get_tacho_max_speed(sn_2, &temp) == 0) {
+    if (!ev3_attr_read_int(EV3_ATTR_TACHO, sn_2, EV3_ATTR_MAX_SPEED, &temp)) {
         printf("Could not read the maximum speed for second arg\n");
         max_speed = -2;
     }
     max_speed = MIN(max_speed, temp); // Get the minimum of the two first motors
-    if (get_tacho_max_speed(sn_3, &temp) == 0) {
+    if (!ev3_attr_read_int(EV3_ATTR_TACHO, sn_3, EV3_ATTR_MAX_SPEED, &temp)) {
         printf("Could not read the maximum speed for third arg\n");
         max_speed = -3;
     }
@@ -208,10 +315,11 @@ int get_min_maxspeed(uint8_t sn_1, uint8_t sn_2, uint8_t sn_3) {
  * @param time the time
  */
 void motor_state_time(uint8_t sn, int speed, int time) {
-    set_tacho_stop_action_inx(sn, TACHO_COAST);
-    set_tacho_speed_sp(sn, speed);
-    set_tacho_time_sp(sn, time);
-    set_tacho_command_inx(sn, TACHO_RUN_TIMED);
+    // Only the values that changed are written, the command always is
+    motor_set_stop_action(sn, TACHO_COAST);
+    motor_set_speed_sp(sn, speed);
+    motor_set_time_sp(sn, time);
+    motor_command(sn, TACHO_RUN_TIMED);
 }
 
 /**
@@ -219,7 +327,7 @@ void motor_state_time(uint8_t sn, int speed, int time) {
  *
  * @param sn the motor
  */
-void stop_motor(uint8_t sn) { set_tacho_command_inx(sn, TACHO_STOP); }
+void stop_motor(uint8_t sn) { motor_command(sn, TACHO_STOP); }
 
 /**
  * @brief Set the motor to run with the default time
@@ -236,65 +344,116 @@ void motor_state(uint8_t sn, int speed) {
  *
  * @param speed_left the speed of the left wheel
  * @param speed_right the speed of the right wheel
- * @param time the time the motor should turn for
+ * @param time the time the motor should turn for if not commanded again
  */
 void move_forward(int speed_left, int speed_right, int time) {
-    motor_state_time(sn_wheel_left, speed_left,
-                     time); // Set the left wheel to run
-    motor_state_time(sn_wheel_right, speed_right,
-                     time); // Set the right wheel to run
+    // The wheels keep running, only the speeds that changed are written
+    drive_speed(speed_left, speed_right, time);
 }
 
 /**
  * @brief Move the robot in a straigh line accoring to gyro_ref
+ * A PID on the heading speeds up one wheel and slows down the other by the
+ * same amount, so the robot keeps its speed while it corrects.
  *
  * @param speed_default the baseline speed
  * @param time the time the motor should turn
  * @param gyro_ref the value of reference for the gyroscope
  */
 void move_straight(int speed_default, int time, float default_gyro) {
-    float speed_left;
-    float speed_right;
-
-    // This part of the code is used to correct the trajectory of the robot.
-    // The two motor are not synchronized and the robot tend to turn to the left
-    // so we rectify that
-    update_gyro();
-    int diff = (int)(default_gyro - gyro_now) % 360;
-    if (diff != 0) {
-        float mul = 1 + (float)abs(diff) / 10;
-        if (diff > 0) {
-            speed_left = mul * speed_default;
-            speed_right = 1.0 * speed_default;
-        } else if (diff < 0) {
-            speed_left = 1.0 * speed_default;
-            speed_right = mul * speed_default;
-        }
-        // printf("%f, %f, %f\n", mul, speed_left, speed_right);
-    } else {
-        speed_right = speed_default;
-        speed_left = speed_default;
+    HUB_SAMPLE sample;
+    if (!sensor_hub_latest(HUB_GYRO, &sample)) {
+        move_forward(speed_default, speed_default, time);
+        return;
+    }
+    gyro_now = (int)sample.values.value[0];
+    if (!heading_pid.valid || (default_gyro != heading_target)) {
+        HEADING_PID_GAINS gains = {
+            params.heading_kp / 1000.0f, params.heading_ki / 1000.0f,
+            params.heading_kd / 1000.0f, HEADING_LIMIT};
+        heading_pid_init(&heading_pid, &gains);
+        heading_target = default_gyro;
+    }
+    float error = heading_error(default_gyro, sample.values.value[0]);
+    // Scaled by |speed|: turning clockwise is the same forward and backward
+    float delta = abs(speed_default) *
+                  heading_pid_update(&heading_pid, error, gyro_rate(&sample),
+                                     sample.time_us);
+    move_forward(lroundf(speed_default + delta),
+                 lroundf(speed_default - delta), time);
+}
+
+/**
+ * @brief Get the distance travelled since the start
+ * The odometry is updated at every tick, and here in case the program slept
+ * since the last one.
+ *
+ * @return double the distance (mm)
+ */
+double travelled(void) {
+    odometry_update();
+    return odometry_distance();
+}
+
+/**
+ * @brief Start a move by position, with run-to-rel-pos on both wheels
+ * The firmware of the motors runs the move, move_done polls their state at
+ * each tick. If the robot is blocked, it gives up after twice the time the
+ * move should take.
+ *
+ * @param count_left the counts of the left wheel
+ * @param count_right the counts of the right wheel
+ * @param speed the speed of the wheels
+ */
+void move_start(int count_left, int count_right, int speed) {
+    move_limit = timeInMilliseconds() + 1000 +
+                 2000LL * abs(count_left) / (abs(speed) + 1);
+    if (!drive_to_position(count_left, count_right, abs(speed), DRIVE_RAMP)) {
+        move_limit = 0; // Nothing to wait for
     }
-    move_forward(speed_left, speed_right, time);
 }
 
 /**
- * @brief Move straight for a set amount of time
- * 
- * @param milliseconds the time we will move straight for
- * @param reference_angle the reference angle we will use
- * @param speed_default the speed at which it will move
+ * @brief Start a move straight for a distance, see move_start
+ *
+ * @param distance the distance (mm, < 0 to go back)
+ * @param speed the speed of the wheels
+ */
+void drive_distance_start(int distance, int speed) {
+    int count = lround(distance / mm_per_count);
+    move_start(count, count, speed);
+}
+
+/**
+ * @brief Start a turn in place by an angle, see move_start
+ * The angle comes from the counts of the wheels, not from the gyro.
+ *
+ * @param angle the angle (degrees, > 0 clockwise)
+ * @param speed the speed of the wheels
+ */
+void rotate_by_start(float angle, int speed) {
+    int count =
+        lroundf(angle * M_PI / 180 * (AXLE_WIDTH / 2.0) / mm_per_count);
+    move_start(count, -count, speed);
+}
+
+/**
+ * @brief Tell if the move started by move_start is over
+ *
+ * @return bool true once both wheels stopped, or out of time
+ */
+bool move_done(void) {
+    return (drive_position_state() != DRIVE_MOVING) ||
+           (timeInMilliseconds() >= move_limit);
+}
+
+/**
+ * @brief Stop the move started by move_start if it is out of time
  */
-void move_straight_for(int milliseconds, float reference_angle,
-                       int speed_default) {
-    long long start = timeInMilliseconds();
-    long long now = start;
-    while ((now - start) < milliseconds) {
-        move_straight(speed_default, DEFAULT_TIME, reference_angle);
-        now = timeInMilliseconds();
+void move_exit(void) {
+    if (drive_position_state() == DRIVE_MOVING) {
+        drive_stop();
     }
-    stop_motor(sn_wheel_left);
-    stop_motor(sn_wheel_right);
 }
 
 /**
@@ -304,8 +463,7 @@ void move_straight_for(int milliseconds, float reference_angle,
  * @param time the time
  */
 void turn_left(int speed, int time) {
-    motor_state_time(sn_wheel_left, 0, time); // only one wheel turn
-    motor_state_time(sn_wheel_right, speed, time);
+    drive_speed(0, speed, time); // only one wheel turn
 }
 
 /**
@@ -315,8 +473,7 @@ void turn_left(int speed, int time) {
  * @param time the time
  */
 void turn_right(int speed, int time) {
-    motor_state_time(sn_wheel_left, speed, time); // same as before
-    motor_state_time(sn_wheel_right, 0, time);
+    drive_speed(speed, 0, time); // same as before
 }
 
 /**
@@ -326,8 +483,7 @@ void turn_right(int speed, int time) {
  * @param time the time
  */
 void turn_right_in_place(int speed, int time) {
-    motor_state_time(sn_wheel_left, speed, time);
-    motor_state_time(sn_wheel_right, -speed, time);
+    drive_speed(speed, -speed, time);
 }
 
 /**
@@ -337,6 +493,9 @@ void turn_right_in_place(int speed, int time) {
  * @param time the time
  */
 void open_clamp(float speed, int time) {
+    clamp_state =
+        (speed > 0) ? TELEMETRY_CLAMP_OPENING : TELEMETRY_CLAMP_CLOSING;
+    clamp_speed = -speed;
     motor_state_time(sn_clamp, -speed, time);
 }
 
@@ -352,179 +511,289 @@ void close_clamp(float speed,
 }
 
 /**
- * @brief Function that ease catching the flag
- * We start by opening the clamp, then we move a little forward. The we close the clamp and get the color sensor value. If the sensor cannot see a color, it means there is the flag in front of it.
+ * @brief Keep the clamp running, so the flag does not fall
  *
- * @param speed the speed
  */
-bool catch_flag(int speed, float ref_angle) {
-    open_clamp(speed, 2000);
-    Sleep(500);
-    move_straight_for(500, ref_angle, speed);
-    Sleep(1000);
-    close_clamp(speed, 2000);
-    Sleep(2000);
-    int num = 6;
-    int compt = 0;
-    for (int i = 0; i < num; i++) {
-        int k = get_color_from_sensor();
-        printf("\r%6s", color[k]);
-        fflush(stdout);
-        if (k == 0) {
-            compt++;
-        }
-        Sleep(250);
-    }
-    return compt == num;
-}
-
-/**
- * @brief Turn to 
- * 
- * @param speed 
- * @param gyro_ref 
- * @param marge 
- */
-void turn_to(int speed, float gyro_ref, int marge) {
-    update_gyro();
-    bool quit = false;
-    gyro_ref = (int)gyro_ref;
-    float diff;
-    while (!quit) {
-        gyro_now = gyro_now;
-        // Should be better
-        // diff = ((int) (gyro_ref - gyro_now) % 360) - 180;
-        diff = gyro_ref - gyro_now;
-        if (diff > 0) {
-            turn_right(speed, DEFAULT_TIME);
-        } else if (diff < 0) {
-            turn_left(speed, DEFAULT_TIME);
-        }
-        update_gyro();
-        quit = (-marge <= diff) && (diff <= marge);
+void hold_clamp(void) {
+    clamp_state = TELEMETRY_CLAMP_HOLDING;
+    motor_command(sn_clamp, TACHO_RUN_FOREVER);
+}
+
+/**
+ * @brief Stop the clamp
+ *
+ */
+void stop_clamp(void) {
+    clamp_state = TELEMETRY_CLAMP_STOPPED;
+    clamp_speed = 0;
+    stop_motor(sn_clamp);
+}
+
+/**
+ * @brief A turn in place run a tick at a time, see turn_start
+ */
+typedef struct {
+    TURN_PROFILE profile;
+    float target;
+    int marge;
+    long long limit;   // Give up at (ms)
+    long long last_us; // Time of the last step
+    float rate;        // Commanded at the last step (degrees / s)
+    bool done;
+} TURN;
+
+/**
+ * @brief Start a turn in place to an angle, on the shortest way
+ * The rate follows a trapezoidal profile so the robot slows down before the
+ * angle instead of going past it and coming back. The turn gives up when it
+ * took TURN_SETTLE more than the profile.
+ *
+ * @param t the turn
+ * @param speed the largest speed of the wheels
+ * @param gyro_ref the angle to turn to
+ * @param marge the error allowed (degrees)
+ */
+void turn_start(TURN *t, int speed, float gyro_ref, int marge) {
+    // Rate of the robot when the wheels go at +-speed
+    float max_rate = abs(speed) * mm_per_count / (AXLE_WIDTH / 2.0) * 180 / M_PI;
+    t->profile = (TURN_PROFILE){max_rate, TURN_ACCEL, TURN_MIN_RATE};
+    t->target = (int)gyro_ref;
+    t->marge = marge;
+    float diff = heading_error(t->target, update_gyro());
+    t->limit = timeInMilliseconds() + TURN_SETTLE +
+               lroundf(1000 * turn_profile_time(&t->profile, diff));
+    t->last_us = tick_time_us();
+    t->rate = 0;
+    t->done = false;
+}
+
+/**
+ * @brief Run a tick of a turn, the wheels are stopped at its end
+ *
+ * @param t the turn
+ * @return bool true once the angle is reached, or out of time
+ */
+bool turn_step(TURN *t) {
+    float diff = heading_error(t->target, update_gyro());
+    if ((fabsf(diff) <= t->marge) || (timeInMilliseconds() >= t->limit)) {
+        drive_stop();
+        t->done = true;
+        return true;
     }
+    long long now = tick_time_us();
+    t->rate = turn_profile_rate(&t->profile, diff, t->rate,
+                                (now - t->last_us) / 1e6f);
+    t->last_us = now;
+    turn_right_in_place(lroundf(t->rate * M_PI / 180 * (AXLE_WIDTH / 2.0) /
+                                mm_per_count),
+                        DEFAULT_TIME);
+    return false;
 }
 
-void bypass_obstacle(int speed, float reference_angle, bool obstacle) {
-    // If we want to be sure there is no longer an opponent in front
-    // Sleep(3000);
-    // update_sonar();
-    // if (val_sonar >= 200) {
-    //     printf("There is no opponent\n");
-    //     return;
-    // }
-    if (obstacle) {
-        move_straight_for(2000, reference_angle, -speed);
+/**
+ * @brief Initialize the motors and sensors of the robot
+ *
+ * @return int the success status
+ */
+int init_robot(void) {
+    uint8_t sn;
+    printf("Waiting tacho is plugged...\n");
+    while (!ev3_attr_search(EV3_ATTR_TACHO, EV3_ATTR_ADDRESS, NULL, &sn, 0) &&
+           !ev3_attr_search(EV3_ATTR_SENSOR, EV3_ATTR_ADDRESS, NULL, &sn, 0)) {
+        Sleep(1000);
+    }
+
+    int missing = registry_resolve(roles, ROLE_COUNT);
+    for (int i = 0; i < missing; i++) {
+        printf("Found %s\n", roles[i].name);
+    }
+    if (missing < ROLE_COUNT) {
+        printf("Could not find %s\n", roles[missing].name);
+        return 2 + missing;
     }
-    turn_to(speed, reference_angle - 90, 1);
-    update_sonar();
-    while (val_sonar >= 270) {
-        move_straight(2 * speed, DEFAULT_TIME, reference_angle - 90);
-        update_sonar();
+    for (int i = 0; i < ROLE_COUNT; i++) {
+        if (!registry_get(i, &device[i])) { // Gone since registry_resolve
+            printf("Lost %s\n", roles[i].name);
+            return 2 + i;
+        }
+        *sn_role[i] = device[i].sn;
     }
-    turn_to(speed, reference_angle, 1);
-    int time_forward = 1;
-    if (obstacle) {
-        time_forward++;
+
+    // Angle and rate in the same read, the control and the logs need both
+    if (!ev3_attr_write(EV3_ATTR_SENSOR, sn_gyro, EV3_ATTR_MODE, "GYRO-G&A")) {
+        printf("Could not set the mode of the gyroscope\n");
+        return 11;
     }
-    long long start = timeInMilliseconds();
-    long long now = start;
-    update_sonar();
-    while ((now - start < time_forward * 1000) && (val_sonar > 300)) {
-        move_straight(2 * speed, DEFAULT_TIME, reference_angle);
-        now = timeInMilliseconds();
-        update_sonar();
+    sensor_hub_configure(HUB_SONAR, sn_sonar, SONAR_PERIOD);
+    sensor_hub_configure(HUB_GYRO, sn_gyro, GYRO_PERIOD);
+    sensor_hub_configure(HUB_COLOR, sn_color, COLOR_PERIOD);
+    sensor_hub_configure(HUB_WHEEL_LEFT, sn_wheel_left, WHEEL_PERIOD);
+    sensor_hub_configure(HUB_WHEEL_RIGHT, sn_wheel_right, WHEEL_PERIOD);
+    if (sensor_hub_start()) {
+        printf("Could not start the sensor thread\n");
+        return 8;
     }
-    while (val_sonar < 270) {
-        move_forward(-speed, -speed, DEFAULT_TIME);
-        update_sonar();
+    if (!sensor_hub_gyro_calibrate(GYRO_CALIBRATION)) {
+        printf("Could not estimate the bias of the gyro, moved?\n");
+    } else {
+        printf("Bias of the gyro: %.3f deg/s\n", sensor_hub_gyro_bias());
     }
-    turn_to(speed, reference_angle + 90, 1);
-    update_sonar();
-    while (val_sonar >= 270) {
-        move_straight(2 * speed, DEFAULT_TIME, reference_angle + 90);
-        update_sonar();
+
+    int count_left;
+    int count_right;
+    if (!ev3_attr_read_int(EV3_ATTR_TACHO, sn_wheel_left,
+                           EV3_ATTR_COUNT_PER_ROT, &count_left) ||
+        !ev3_attr_read_int(EV3_ATTR_TACHO, sn_wheel_right,
+                           EV3_ATTR_COUNT_PER_ROT, &count_right) ||
+        (count_left <= 0) || (count_right <= 0) ||
+        !odometry_init(M_PI * WHEEL_DIAMETER / count_left,
+                       M_PI * WHEEL_DIAMETER / count_right)) {
+        printf("Could not start the odometry\n");
+        return 10;
     }
-    turn_to(speed, reference_angle, 1);
-    update_sonar();
-    while (val_sonar < 270) {
-        move_forward(-speed, -speed, DEFAULT_TIME);
-        update_sonar();
+    mm_per_count = M_PI * WHEEL_DIAMETER / count_left;
+
+    drive_init(sn_wheel_left, sn_wheel_right);
+    if (drive_deadman_start()) {
+        printf("Could not start the deadman thread\n");
+        return 9;
     }
+    return 0;
 }
 
-void bypass_back(int speed, float reference_angle, bool obstacle) {
-    if (obstacle) {
-        move_straight_for(2000, reference_angle, -2 * speed);
+/**
+ * @brief Use the new device of a role, that came back under another sn
+ *
+ * @param role the role
+ * @param sn its new sequence number
+ */
+void use_device(int role, uint8_t sn) {
+    static const int hub_slot[ROLE_COUNT] = {
+        [ROLE_SONAR] = HUB_SONAR,
+        [ROLE_GYRO] = HUB_GYRO,
+        [ROLE_COLOR] = HUB_COLOR,
+        [ROLE_WHEEL_LEFT] = HUB_WHEEL_LEFT,
+        [ROLE_WHEEL_RIGHT] = HUB_WHEEL_RIGHT,
+        [ROLE_CLAMP] = -1,
+    };
+    printf("%s is now %d\n", roles[role].name, sn);
+    *sn_role[role] = sn;
+    if ((role == ROLE_GYRO) &&
+        !ev3_attr_write(EV3_ATTR_SENSOR, sn, EV3_ATTR_MODE, "GYRO-G&A")) {
+        printf("Could not set the mode of the gyroscope\n");
     }
-    turn_to(speed, reference_angle - 90, 1);
-    update_sonar();
-    while (val_sonar >= 300) {
-        move_straight(2 * speed, DEFAULT_TIME, reference_angle - 90);
-        update_sonar();
+    if ((role == ROLE_WHEEL_LEFT) || (role == ROLE_WHEEL_RIGHT)) {
+        drive_init(sn_wheel_left, sn_wheel_right);
     }
-    turn_to(speed, reference_angle, 1);
-    update_sonar();
-    while (val_sonar < 300) {
-        move_forward(-speed, -speed, DEFAULT_TIME);
-        update_sonar();
+    if (hub_slot[role] >= 0) {
+        sensor_hub_set_device(hub_slot[role], sn);
     }
 }
 
 /**
- * @brief Initialize the motors and sensors of the robot
- *
- * @return int the success status
+ * @brief Check the handle of every role
+ * It is a comparison of generations. Once an access to a device failed, the
+ * registry searches it again, at most every DEVICE_SEARCH_PERIOD while it is
+ * missing.
  */
-int init_robot(void) {
-    if (ev3_init() == -1)
-        return 1;
-    printf("Waiting tacho is plugged...\n");
-    while ((ev3_tacho_init() < 1) & (ev3_sensor_init() < 1)) {
-        Sleep(1000);
+void check_devices(void) {
+    static long long next_search = 0;
+    long long now = timeInMilliseconds();
+    bool missing = false;
+    for (int i = 0; i < ROLE_COUNT; i++) {
+        DEVICE_HANDLE handle;
+        if (registry_valid(&device[i]) || (now < next_search)) {
+            continue;
+        }
+        if (!registry_get(i, &handle)) {
+            missing = true;
+            continue;
+        }
+        if (handle.sn != device[i].sn) {
+            use_device(i, handle.sn);
+        }
+        device[i] = handle;
     }
+    if (missing) {
+        next_search = now + DEVICE_SEARCH_PERIOD;
+    }
+}
 
-    if (ev3_search_sensor(LEGO_EV3_US, &sn_sonar, 0)) {
-        printf("Found the sonar\n");
-    } else {
-        printf("Could not find the sonar\n");
-        return 2;
+_Static_assert(TELEMETRY_SAMPLES == HUB_SENSOR_COUNT, "samples of the log");
+
+/**
+ * @brief Write the state of the robot at the end of the tick in the log
+ *
+ */
+void log_tick(void) {
+    TELEMETRY_RECORD record = {0};
+    HUB_SAMPLE sample[HUB_SENSOR_COUNT];
+    int cmd_left;
+    int cmd_right;
+
+    record.time_us = clock_now_us();
+    record.tick_us = tick_time_us();
+    record.wake_us = tick_wake_us() - record.tick_us;
+    record.tick = tick_count++;
+    record.action = action;
+    for (int id = 0; id < HUB_SENSOR_COUNT; id++) {
+        record.sample_us[id] = sensor_hub_latest(id, &sample[id])
+                                   ? sample[id].time_us - record.tick_us
+                                   : TELEMETRY_NO_SAMPLE;
     }
-    if (ev3_search_sensor(LEGO_EV3_GYRO, &sn_gyro, 0)) {
-        printf("Found the gyroscope\n");
-    } else {
-        printf("Could not find the gyroscope\n");
-        return 3;
+    if (sample[HUB_SONAR].count) {
+        record.sonar_raw = sample[HUB_SONAR].values.value[0];
     }
-    if (ev3_search_sensor(LEGO_EV3_COLOR, &sn_color, 0)) {
-        printf("Found the color sensor\n");
-    } else {
-        printf("Could not find color sensor\n");
-        return 4;
+    record.sonar = sonar_filtered;
+    if (sample[HUB_GYRO].count) {
+        record.gyro = sample[HUB_GYRO].values.value[0];
+        if (sample[HUB_GYRO].values.count >= 2) { // Else not read, left at 0
+            record.gyro_rate = sample[HUB_GYRO].values.value[1];
+        }
     }
-    if (!is_motor_here(port_wheel_left, &sn_wheel_left, "Found the left wheel",
-                       "Could not find the left wheel")) {
-        return 5;
+    if (sample[HUB_COLOR].count) {
+        record.color = sample[HUB_COLOR].values.value[0];
     }
-    if (!is_motor_here(port_wheel_right, &sn_wheel_right,
-                       "Found the right wheel",
-                       "Could not find the right wheel")) {
-        return 6;
+    if (sample[HUB_WHEEL_LEFT].count) {
+        record.speed_left = sample[HUB_WHEEL_LEFT].values.value[0];
+        record.position_left = sample[HUB_WHEEL_LEFT].values.value[1];
     }
-    if (!is_motor_here(port_clamp, &sn_clamp, "Found the clamp",
-                       "Could not find the clamp")) {
-        return 7;
+    if (sample[HUB_WHEEL_RIGHT].count) {
+        record.speed_right = sample[HUB_WHEEL_RIGHT].values.value[0];
+        record.position_right = sample[HUB_WHEEL_RIGHT].values.value[1];
     }
-    return 0;
+    drive_get_command(&cmd_left, &cmd_right);
+    record.cmd_left = cmd_left;
+    record.cmd_right = cmd_right;
+    record.state_left = motor_last_state(sn_wheel_left);
+    record.state_right = motor_last_state(sn_wheel_right);
+    record.state_clamp = motor_last_state(sn_clamp);
+    record.cmd_clamp = clamp_speed;
+    record.clamp = clamp_state;
+    telemetry_log(&record);
+}
+
+/**
+ * @brief Called by the scheduler at the end of every tick
+ *
+ */
+void end_tick(void) {
+    check_devices();
+    odometry_update();
+    log_tick();
 }
 
 void *thread_play_sound() {
+    if (!PLAY_SOUND) {
+        return NULL;
+    }
     sound_pid = fork();
 
     if (step == 0) {
         step = 1;
         if (sound_pid == 0) { // This block will be run by the child process
             execlp("aplay", "aplay", "dubstep.wav", NULL);
+            _exit(1); // Could not play it, the child must not go on
         }
     }
     if (step == 1) {
@@ -532,12 +801,546 @@ void *thread_play_sound() {
             execlp("/bin/sh", "/bin/sh", "-c",
                    "espeak \"viva la revolution\" --stdout -v spanish | aplay",
                    NULL);
+            _exit(1);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * The mission, as a table of states run by src/mission. The number of a state
+ * is the action of the logs and of the instrumentation.
+ */
+
+enum {
+    STATE_START = 0,         // Turn to 45° the right
+    STATE_TO_WALL = 1,       // starting position -> wall
+    STATE_ACROSS = 2,        // wall right -> wall other side
+    STATE_FLAG = 3,          // move straight while closing the clamp
+    STATE_RETURN = 4,        // Speed to our camp
+    STATE_DROP = 5,          // In the base: face it,
+    STATE_WAIT = 6,          // Wait for the time the opponent may cross
+    STATE_CATCH_OPEN = 7,    // Catch of the flag: open the clamp,
+    STATE_CATCH_ADVANCE = 8, // move into the flag,
+    STATE_CATCH_CLOSE = 9,   // close the clamp on it,
+    STATE_RETRY = 10,        // Did not found the flag, turn back,
+    STATE_CATCH_CHECK = 11,  // and look for it with the color sensor
+    STATE_AVOID_BACK = 12,   // Opponent while crossing: back away from it,
+    STATE_AVOID_OUT = 13,    // go aside up to the wall,
+    STATE_AVOID_PASS = 14,   // forward past the opponent,
+    STATE_AVOID_IN = 15,     // back toward the middle,
+    STATE_AVOID_ALIGN = 16,  // and face the other side again
+    STATE_RETURN_TURN = 17,  // With the flag: face our camp
+    STATE_RETURN_STOP = 18,  // Something very close on the way: wait
+    STATE_DODGE_BACK = 19,   // Opponent on the way: back away from it,
+    STATE_DODGE_OUT = 20,    // go aside,
+    STATE_DODGE_IN = 21,     // and face our camp again
+    STATE_DROP_OPEN = 22,    // open the clamp,
+    STATE_DROP_ROTATE = 23,  // turn away from the flag,
+    STATE_DROP_LEAVE = 24,   // and let the clamp open
+    STATE_RETRY_ADVANCE = 25, // move a bit toward the other side,
+    STATE_RETRY_TURN = 26,   // face it and go,
+    STATE_RETRY_BACK = 27,   // back away from a wall too close
+    STATE_COUNT
+};
+
+// Set by main before the mission starts
+int speed_move_default;
+int speed_return;
+int speed_clamp;
+int speed_right;
+int speed_left;
+float gyro_val_start;
+float first_angle;
+float second_angle;
+float third_angle;
+float fourth_angle;
+float fifth_angle;
+float tenth_angle;
+long long start_time; // Of the mission (ms)
+
+float ref_angle_fourth_phase;
+float sonar = 0; // Value of the sonar for this tick
+bool can_catch = true;
+TURN turn;                // Started by the enter of the states that turn
+bool opponent_close;      // Met while crossing, the bypass backs away first
+double pass_start;        // Odometry distance when passing the opponent
+bool passed;              // The opponent was passed, backing away from wall
+SPRT flag_test;           // On the reads of the color after the catch
+int flag_result;          // SPRT_CONTINUE until it is decided
+uint32_t color_count;     // Number of the last color sample used
+long long color_used_us;  // Time of the last sample counted by the test
+long long check_start;    // Time the test started (us)
+MISSION mission;
+
+/**
+ * @brief Run a tick of the turn started by the enter of the state
+ *
+ * @return bool true once it is over, the state can move
+ */
+bool turn_over(void) {
+    if (turn.done) {
+        return true;
+    }
+    turn_step(&turn);
+    return false;
+}
+
+/* Guards of the transitions */
+
+bool turned(void) { return turn.done; }
+
+bool first_wall(void) { return sonar < params.wall_first; }
+
+bool second_wall(void) {
+    return turn.done && (sonar < params.wall_second) &&
+           (timeInMilliseconds() - start_time >= params.obstacle_window);
+}
+
+bool opponent_ahead(void) { // Before obstacle_window, see second_wall
+    return turn.done && (sonar < params.wall_second);
+}
+
+bool wall_aside(void) {
+    return turn.done && (sonar < params.aside_wall);
+}
+
+bool way_clear(void) {
+    return turn.done && (sonar >= params.aside_wall);
+}
+
+bool passed_clear(void) { return passed && way_clear(); }
+
+bool wait_over(void) {
+    return turn.done &&
+           (timeInMilliseconds() - start_time >= params.start_wait);
+}
+
+bool third_wall_flag(void) {
+    return (sonar < params.wall_third) && !can_catch;
+}
+
+bool third_wall_no_flag(void) {
+    return (sonar < params.wall_third) && can_catch;
+}
+
+bool flag_ahead(void) {
+    return (sonar < params.flag_far) && (sonar > params.flag_near) && can_catch;
+}
+
+bool clamp_done(void) {
+    FLAGS_T flags;
+    if (mission_state_time(&mission) >= CLAMP_TIME) {
+        return true;
+    }
+    // At a stop, the clamp stalls until the end of its time
+    return motor_get_state(sn_clamp, &flags) &&
+           (!(flags & TACHO_RUNNING) || (flags & TACHO_STALLED));
+}
+
+bool flag_seen(void) { return flag_result == SPRT_ACCEPT; }
+
+bool flag_missed(void) {
+    return (flag_result == SPRT_REJECT) ||
+           ((flag_result == SPRT_CONTINUE) &&
+            (flag_test.count >= FLAG_READS_MAX));
+}
+
+bool too_close(void) { return sonar <= params.return_stop; }
+
+bool stop_over(void) {
+    return mission_state_time(&mission) >= RETURN_STOP_TIME;
+}
+
+bool stuck(void) { return stop_over() && (sonar < params.return_stop); }
+
+bool return_blocked(void) {
+    return (sonar <= params.return_bypass) &&
+           (travelled() - distance_4 < params.return_distance);
+}
+
+bool base_reached(void) {
+    return (sonar > params.return_stop) && (sonar <= params.return_base) &&
+           !return_blocked();
+}
+
+bool dodge_aside(void) {
+    return turn.done && (sonar < params.aside_clear);
+}
+
+bool dodge_clear(void) {
+    return turn.done && (sonar >= params.aside_clear);
+}
+
+bool drop_opening(void) {
+    return mission_state_time(&mission) >= DROP_OPEN_TIME;
+}
+
+bool drop_open(void) {
+    return mission_state_time(&mission) >= DROP_LEAVE_TIME;
+}
+
+bool retry_wall(void) {
+    return turn.done && (sonar > params.retry_near) &&
+           (sonar <= params.retry_far);
+}
+
+bool retry_too_close(void) {
+    return turn.done && (sonar <= params.retry_near);
+}
+
+/* Handlers of the states */
+
+void start_enter(void) {
+    turn_start(&turn, 2 * speed_move_default, first_angle, 1);
+}
+
+void turn_tick(void) { turn_over(); }
+
+void to_wall_tick(void) {
+    move_straight(speed_move_default, DEFAULT_TIME, first_angle);
+}
+
+void across_enter(void) {
+    turn_start(&turn, speed_move_default, second_angle, 1);
+}
+
+void across_tick(void) {
+    if (turn_over()) {
+        move_straight(speed_move_default, DEFAULT_TIME, second_angle);
+    }
+}
+
+void avoid_back_enter(void) {
+    long long diff = timeInMilliseconds() - start_time;
+    printf("turning: %lld\n", diff);
+    opponent_close = (diff < params.obstacle_back_max) &&
+                     (diff > params.obstacle_back_min);
+    move_limit = 0;
+    if (opponent_close) {
+        drive_distance_start(-OBSTACLE_BACK, speed_move_default);
+    }
+}
+
+void avoid_out_enter(void) {
+    turn_start(&turn, speed_move_default, gyro_val_start - 90, 1);
+}
+
+void avoid_out_tick(void) {
+    if (turn_over()) {
+        move_straight(2 * speed_move_default, DEFAULT_TIME,
+                      gyro_val_start - 90);
+    }
+}
+
+void avoid_pass_enter(void) {
+    turn_start(&turn, speed_move_default, gyro_val_start, 1);
+    passed = false;
+}
+
+void avoid_pass_tick(void) {
+    if (!turn_over()) {
+        pass_start = travelled(); // The pass starts at the end of the turn
+        return;
+    }
+    int distance = BYPASS_FORWARD * (opponent_close ? 2 : 1);
+    if (!passed && (travelled() - pass_start < distance) &&
+        (sonar > params.aside_clear)) {
+        move_straight(2 * speed_move_default, DEFAULT_TIME, gyro_val_start);
+        return;
+    }
+    passed = true;
+    if (sonar < params.aside_wall) { // Too close to the wall to turn
+        move_forward(-speed_move_default, -speed_move_default, DEFAULT_TIME);
+    }
+}
+
+void avoid_in_enter(void) {
+    turn_start(&turn, speed_move_default, gyro_val_start + 90, 1);
+}
+
+void avoid_in_tick(void) {
+    if (turn_over()) {
+        move_straight(2 * speed_move_default, DEFAULT_TIME,
+                      gyro_val_start + 90);
+    }
+}
+
+void avoid_align_enter(void) {
+    turn_start(&turn, speed_move_default, gyro_val_start, 1);
+}
+
+void back_off_tick(void) { // Until way_clear
+    if (turn_over()) {
+        move_forward(-speed_move_default, -speed_move_default, DEFAULT_TIME);
+    }
+}
+
+void wait_enter(void) { turn_start(&turn, speed_clamp, third_angle, 0); }
+
+void wait_tick(void) {
+    static long long shown = -1;
+    if (!turn_over()) {
+        return;
+    }
+    long long left = (params.start_wait - (timeInMilliseconds() - start_time)) /
+                     1000;
+    if (left != shown) {
+        shown = left;
+        printf("\rMoving again in %2lld", left);
+        fflush(stdout);
+    }
+}
+
+void wait_exit(void) { printf("\rStarting now !           \n"); }
+
+void flag_tick(void) {
+    if (sonar <= params.flag_near) {
+        close_clamp(speed_clamp, 1000);
+        move_straight(speed_move_default, DEFAULT_TIME, third_angle);
+    } else {
+        if (sonar > params.clamp_open) {
+            open_clamp(speed_move_default, 1000);
         }
+        move_straight(speed_left, speed_right, third_angle);
+    }
+}
+
+void catch_open_enter(void) {
+    drive_stop();
+    open_clamp(speed_clamp, CLAMP_TIME);
+}
+
+void catch_advance_enter(void) {
+    drive_distance_start(CATCH_ADVANCE, speed_clamp);
+}
+
+void catch_close_enter(void) { close_clamp(speed_clamp, CLAMP_TIME); }
+
+void catch_check_enter(void) {
+    sprt_init(&flag_test, FLAG_P_SEEN, FLAG_P_FALSE, FLAG_ALPHA, FLAG_BETA);
+    flag_result = SPRT_CONTINUE;
+    check_start = tick_time_us();
+    color_used_us = check_start - FLAG_MIN_GAP * 1000LL;
+}
+
+void catch_check_tick(void) {
+    HUB_SAMPLE sample;
+    // Only the samples read once the clamp is closed, each one once, and
+    // FLAG_MIN_GAP apart: the robot does not move, the next reads of the
+    // sensor would repeat the same error and the test would trust it
+    if (!sensor_hub_latest(HUB_COLOR, &sample) ||
+        (sample.count == color_count) || (sample.time_us < check_start) ||
+        (sample.time_us - color_used_us < FLAG_MIN_GAP * 1000LL)) {
+        return;
+    }
+    color_count = sample.count;
+    color_used_us = sample.time_us;
+    int k = color_index(sample.values.value[0]);
+    printf("\r%6s", color[k]);
+    fflush(stdout);
+    // The sensor sees no color, the flag is in front of it
+    flag_result = sprt_add(&flag_test, k == 0);
+}
+
+void catch_check_exit(void) {
+    can_catch = !flag_seen();
+    printf("\rFlag test: %s after %d reads, %lld ms\n",
+           can_catch ? "no flag" : "flag", flag_test.count,
+           (tick_time_us() - check_start) / 1000);
+    if (!can_catch) {
+        printf("\rFOUND THE FLAG!!! FOUND THE FLAG!!!\n");
+        pthread_t sound_thread;
+        pthread_create(&sound_thread, NULL, thread_play_sound, NULL);
+        pthread_detach(sound_thread);
+    }
+}
+
+void return_turn_enter(void) {
+    turn_start(&turn, speed_clamp, fourth_angle, 0);
+}
+
+void return_turn_exit(void) {
+    hold_clamp();
+    distance_4 = travelled();
+}
+
+void return_tick(void) {
+    move_straight(speed_return, DEFAULT_TIME, ref_angle_fourth_phase);
+}
+
+void return_stop_enter(void) { move_forward(0, 0, DEFAULT_TIME); }
+
+void dodge_back_enter(void) {
+    ref_angle_fourth_phase = fourth_angle + 12;
+    move_limit = 0;
+    if (timeInMilliseconds() - start_time < params.return_back) {
+        drive_distance_start(-RETURN_BACK, 2 * speed_move_default);
+    }
+}
+
+void dodge_out_enter(void) {
+    turn_start(&turn, speed_move_default, ref_angle_fourth_phase - 90, 1);
+}
+
+void dodge_out_tick(void) {
+    if (turn_over()) {
+        move_straight(2 * speed_move_default, DEFAULT_TIME,
+                      ref_angle_fourth_phase - 90);
     }
 }
 
+void dodge_in_enter(void) {
+    turn_start(&turn, speed_move_default, ref_angle_fourth_phase, 1);
+}
+
+void dodge_in_tick(void) { // Until dodge_clear
+    if (turn_over()) {
+        move_forward(-speed_move_default, -speed_move_default, DEFAULT_TIME);
+    }
+}
+
+void drop_enter(void) {
+    stop_clamp();
+    turn_start(&turn, speed_return, fifth_angle, 1);
+}
+
+void drop_open_enter(void) {
+    move_forward(0, 0, DEFAULT_TIME);
+    open_clamp(speed_clamp, 2000);
+}
+
+void drop_rotate_enter(void) { rotate_by_start(END_ROTATE, speed_clamp); }
+
+void retry_enter(void) { turn_start(&turn, speed_clamp, fourth_angle, 0); }
+
+void retry_advance_enter(void) {
+    drive_distance_start(NO_FLAG_ADVANCE, speed_move_default);
+}
+
+void retry_turn_enter(void) {
+    turn_start(&turn, speed_move_default, tenth_angle, 1);
+}
+
+void retry_turn_tick(void) {
+    if (turn_over()) {
+        move_straight(2 * speed_move_default, DEFAULT_TIME, tenth_angle);
+    }
+}
+
+void retry_back_enter(void) {
+    drive_distance_start(-WALL_BACK, speed_move_default);
+}
+
+// Budgets from the matches of the simulator, with some margin
+const MISSION_STATE mission_table[STATE_COUNT] = {
+    [STATE_START] = {"start", start_enter, turn_tick, NULL, 3000,
+                     {{turned, STATE_TO_WALL, "facing the first wall"}}},
+    [STATE_TO_WALL] = {"to_wall", NULL, to_wall_tick, NULL, 8000,
+                       {{first_wall, STATE_ACROSS, "first wall"}}},
+    [STATE_ACROSS] = {"across", across_enter, across_tick, NULL, 15000,
+                      {{second_wall, STATE_WAIT, "wall of the other side"},
+                       {opponent_ahead, STATE_AVOID_BACK, "opponent ahead"}}},
+    [STATE_AVOID_BACK] = {"a_back", avoid_back_enter, NULL, move_exit, 3000,
+                          {{move_done, STATE_AVOID_OUT, "away from it"}}},
+    [STATE_AVOID_OUT] = {"a_out", avoid_out_enter, avoid_out_tick, NULL, 8000,
+                         {{wall_aside, STATE_AVOID_PASS, "wall aside"}}},
+    [STATE_AVOID_PASS] = {"a_pass", avoid_pass_enter, avoid_pass_tick, NULL,
+                          8000,
+                          {{passed_clear, STATE_AVOID_IN, "opponent passed"}}},
+    [STATE_AVOID_IN] = {"a_in", avoid_in_enter, avoid_in_tick, NULL, 8000,
+                        {{wall_aside, STATE_AVOID_ALIGN, "back in the middle"}}},
+    [STATE_AVOID_ALIGN] = {"a_align", avoid_align_enter, back_off_tick, NULL,
+                           5000,
+                           {{way_clear, STATE_ACROSS, "opponent bypassed"}}},
+    [STATE_WAIT] = {"wait", wait_enter, wait_tick, wait_exit, 20000,
+                    {{wait_over, STATE_FLAG, "start_wait is over"}}},
+    [STATE_FLAG] = {"flag", NULL, flag_tick, NULL, 15000,
+                    {{third_wall_flag, STATE_RETURN_TURN, "wall, with the flag"},
+                     {third_wall_no_flag, STATE_RETRY, "wall, no flag"},
+                     {flag_ahead, STATE_CATCH_OPEN, "flag ahead"}}},
+    [STATE_CATCH_OPEN] = {"c_open", catch_open_enter, NULL, NULL, 2500,
+                          {{clamp_done, STATE_CATCH_ADVANCE, "clamp open"}}},
+    [STATE_CATCH_ADVANCE] = {"c_adv", catch_advance_enter, NULL, move_exit,
+                             3000,
+                             {{move_done, STATE_CATCH_CLOSE, "in the flag"}}},
+    [STATE_CATCH_CLOSE] = {"c_close", catch_close_enter, NULL, NULL, 2500,
+                           {{clamp_done, STATE_CATCH_CHECK, "clamp closed"}}},
+    [STATE_CATCH_CHECK] = {"c_check", catch_check_enter, catch_check_tick,
+                           catch_check_exit, 2000,
+                           {{flag_seen, STATE_FLAG, "flag caught"},
+                            {flag_missed, STATE_FLAG, "no flag"}}},
+    [STATE_RETURN_TURN] = {"r_turn", return_turn_enter, turn_tick,
+                           return_turn_exit, 3000,
+                           {{turned, STATE_RETURN, "facing our camp"}}},
+    [STATE_RETURN] = {"return", NULL, return_tick, NULL, 20000,
+                      {{too_close, STATE_RETURN_STOP, "something very close"},
+                       {base_reached, STATE_DROP, "base reached"},
+                       {return_blocked, STATE_DODGE_BACK, "opponent ahead"}}},
+    [STATE_RETURN_STOP] = {"r_stop", return_stop_enter, NULL, NULL, 1500,
+                           {{stuck, MISSION_END, "stuck in front of something"},
+                            {stop_over, STATE_RETURN, "free again"}}},
+    [STATE_DODGE_BACK] = {"d_back", dodge_back_enter, NULL, move_exit, 4000,
+                          {{move_done, STATE_DODGE_OUT, "away from it"}}},
+    [STATE_DODGE_OUT] = {"d_out", dodge_out_enter, dodge_out_tick, NULL, 8000,
+                         {{dodge_aside, STATE_DODGE_IN, "wall aside"}}},
+    [STATE_DODGE_IN] = {"d_in", dodge_in_enter, dodge_in_tick, NULL, 5000,
+                        {{dodge_clear, STATE_RETURN, "opponent dodged"}}},
+    [STATE_DROP] = {"drop", drop_enter, turn_tick, NULL, 3000,
+                    {{turned, STATE_DROP_OPEN, "facing the base"}}},
+    [STATE_DROP_OPEN] = {"dr_open", drop_open_enter, NULL, NULL, 1000,
+                         {{drop_opening, STATE_DROP_ROTATE, "clamp opening"}}},
+    [STATE_DROP_ROTATE] = {"dr_rot", drop_rotate_enter, NULL, move_exit, 3000,
+                           {{move_done, STATE_DROP_LEAVE, "away from the flag"}}},
+    [STATE_DROP_LEAVE] = {"dr_leave", NULL, NULL, NULL, 2000,
+                          {{drop_open, MISSION_END, "flag dropped"}}},
+    [STATE_RETRY] = {"retry", retry_enter, turn_tick, NULL, 3000,
+                     {{turned, STATE_RETRY_ADVANCE, "turned back"}}},
+    [STATE_RETRY_ADVANCE] = {"re_adv", retry_advance_enter, NULL, move_exit,
+                             3000,
+                             {{move_done, STATE_RETRY_TURN, "advanced"}}},
+    [STATE_RETRY_TURN] = {"re_turn", retry_turn_enter, retry_turn_tick, NULL,
+                          10000,
+                          {{retry_wall, STATE_ACROSS, "back on the other side"},
+                           {retry_too_close, STATE_RETRY_BACK, "wall too close"}}},
+    [STATE_RETRY_BACK] = {"re_back", retry_back_enter, NULL, move_exit, 2000,
+                          {{move_done, STATE_RETRY_TURN, "away from the wall"}}},
+};
+
+/**
+ * @brief Name of a state, for the summary of the instrumentation
+ *
+ * @param state the state
+ * @return const char* its name
+ */
+const char *state_name(int state) { return mission_table[state].name; }
+
+/**
+ * @brief Called by the state machine on each transition
+ * action is a global variable, it follows the state for the logs
+ *
+ * @param from the state left, MISSION_END at the start
+ * @param to the state entered, MISSION_END at the end
+ * @param reason why the transition was taken
+ */
+void mission_changed(int from, int to, const char *reason) {
+    (void)from;
+    if (to != MISSION_END) {
+        action = to;
+        instr_set_phase(action);
+    }
+    printf("Action %d (%s): %s\n", to,
+           (to == MISSION_END) ? "end" : mission_table[to].name, reason);
+    printf("%ld\n", time(NULL));
+}
+
 int main(void) {
     int status;
+    if ((status = params_init())) {
+        printf("Could not read the parameters (%d), using the defaults\n",
+               status);
+        params_default(&params);
+    }
     if ((status = init_robot())) {
         return status;
     }
@@ -546,188 +1349,78 @@ int main(void) {
     if (max_speed < 0) {
         return max_speed;
     }
+    tick_init(CONTROL_PERIOD, CONTROL_REALTIME);
+    instr_set_phases(STATE_COUNT, state_name);
+    instr_install_signal(); // kill -USR1 to get the summary during the run
+    if (telemetry_open(TELEMETRY_FILE, TELEMETRY_BLOCKS)) {
+        printf("Could not create the telemetry log, running without it\n");
+    }
+    tick_set_hook(end_tick);
 
-    const int speed_move_default = max_speed / 3;
-    const int speed_return = speed_move_default;
-    const int speed_clamp = max_speed / 5;
-    const int speed_right = speed_move_default;
-    const int speed_left = speed_move_default;
-
-    // Action 0: Turn to 45° the right
-    // Action 1: starting position -> wall, turn to start orientation
-    // Action 2: wall right -> wall other side, turn 90° to the left
-    // Action 3: move straigh while closing the clamp, turn 90° to the left
-    // Action 4: Speed to our camp, turn 90° to the left
-    // Action 5: Move forward, open clamp
-    // Action 10: Did not found the flag during action 3, go back to the other
-    // side and try again
+    speed_move_default = max_speed / params.speed_move_div;
+    speed_return = speed_move_default;
+    speed_clamp = max_speed / params.speed_clamp_div;
+    speed_right = speed_move_default;
+    speed_left = speed_move_default;
 
     /* Here are the angle the robot should follow for all phases */
-    // const float gyro_val_start = turn_until_min(speed_clamp, DEFAULT_TIME);
-    const float gyro_val_start = update_gyro();
-    const float first_angle = gyro_val_start + 45;
-    const float second_angle = gyro_val_start - 2;
-    const float third_angle = gyro_val_start - 90;
-    const float fourth_angle = gyro_val_start - 182;
-    const float fifth_angle = gyro_val_start - 290;
-    const float tenth_angle = gyro_val_start - 270;
-
-    float ref_angle_fourth_phase = fourth_angle;
+    // gyro_val_start = turn_until_min(speed_clamp, DEFAULT_TIME);
+    gyro_val_start = update_gyro();
+    first_angle = gyro_val_start + 45;
+    second_angle = gyro_val_start - 2;
+    third_angle = gyro_val_start - 90;
+    fourth_angle = gyro_val_start - 182;
+    fifth_angle = gyro_val_start - 290;
+    tenth_angle = gyro_val_start - 270;
+    ref_angle_fourth_phase = fourth_angle;
 
     printf("%f, %f, %f, %f, %f, %f\n", gyro_val_start, first_angle,
            second_angle, third_angle, fourth_angle, fifth_angle);
 
-    float sonar = 0;
-    bool quit = false;
-    bool can_catch = true;
-    bool allow_quit = false;
-    // bool entered = false;
-    long long start = timeInMilliseconds();
-    long long now = start;
-
-    while (!quit) {
-        if ((action == 0) || (action == 4)) {
-            get_sensor_value0(sn_sonar, &val_sonar);
-            sonar = val_sonar;
+    start_time = timeInMilliseconds();
+    mission_start(&mission, mission_table, STATE_COUNT, STATE_START,
+                  mission_changed);
+
+    bool running = true;
+    while (running) {
+        tick_wait();
+        if ((action == STATE_START) || (action == STATE_RETURN) ||
+            (action == STATE_RETURN_STOP)) {
+            update_sonar();
+            sonar = val_sonar; // No filtering
         } else {
             sonar = update_sonar();
         }
-        if (!sonar) {
+        if (sonar <= 0) { // No sample yet
             continue;
         }
-
-        // Phase 0
-        if (action == 0) {
-            turn_to(2 * speed_move_default, first_angle, 1);
-            change_action();
-        } else if (sonar > 0) {
-            if (sonar >= DISTANCE_STOP) {
-                allow_quit = false;
-            }
-            if ((sonar <= DISTANCE_STOP) && allow_quit) {
-                quit = true;
-            }
-
-            // Phase 1
-            else if (action == 1) {
-                if (sonar < 280) {
-                    turn_to(speed_move_default, second_angle, 1);
-                    change_action();
-                } else {
-                    move_straight(speed_move_default, DEFAULT_TIME,
-                                  first_angle);
-                }
-                // Phase 2
-            } else if (action == 2) {
-                if (sonar < 230) {
-                    now = timeInMilliseconds();
-                    long long diff = now - start;
-                    printf("turning: %lld\n", diff);
-                    if (diff < 10000) {
-                        bypass_obstacle(speed_move_default, gyro_val_start,
-                                        (diff < 7000) && (diff > 5000));
-                    } else {
-                        turn_to(speed_clamp, third_angle, 0);
-                        now = timeInMilliseconds();
-                        while (start + 20000 > now) {
-                            printf("\rMoving again in %2lld",
-                                   20 - (now - start) / 1000);
-                            fflush(stdout);
-                            Sleep(500);
-                            now = timeInMilliseconds();
-                        }
-                        printf("\rStarting now !           \n");
-                        change_action();
-                        sonar = update_sonar();
-                    }
-                } else {
-                    move_straight(speed_move_default, DEFAULT_TIME,
-                                  second_angle);
-                }
-                // Phase 3
-            } else if (action == 3) {
-                if (sonar < 240) {
-                    turn_to(speed_clamp, fourth_angle, 0);
-                    if (!can_catch) {
-                        // if (entered && !can_catch) {
-                        set_tacho_command_inx(sn_clamp, TACHO_RUN_FOREVER);
-                        change_action();
-                    } else { // We did not found the flag
-                        move_straight_for(1000, fourth_angle,
-                                          speed_move_default);
-                        turn_to(speed_move_default, tenth_angle, 1);
-                        override_action(10);
-                    }
-                    start_4 = timeInMilliseconds();
-                } else if ((sonar < 540) && (sonar > 430) && can_catch) {
-                    can_catch = !catch_flag(speed_clamp, third_angle);
-                    if (!can_catch) {
-                        printf("\rFOUND THE FLAG!!! FOUND THE FLAG!!!\n");
-                        pthread_t sound_thread;
-                        pthread_create(&sound_thread, NULL, thread_play_sound,
-                                       NULL);
-                        pthread_detach(sound_thread);
-                    }
-                } else if (sonar <= 430) {
-                    close_clamp(speed_clamp, 1000);
-                    move_straight(speed_move_default, DEFAULT_TIME,
-                                  third_angle);
-                    // set_tacho_command_inx(sn_clamp, TACHO_RUN_FOREVER);
-                } else {
-                    if (sonar > 600) {
-                        // can_catch = true;
-                        open_clamp(speed_move_default, 1000);
-                    }
-                    // entered = true;
-                    move_straight(speed_left, speed_right, third_angle);
-                }
-            } else if (action == 4) {
-                now = timeInMilliseconds();
-                // printf("%ld\n", now);
-                move_straight(speed_return, DEFAULT_TIME,
-                              ref_angle_fourth_phase);
-                if (sonar <= DISTANCE_STOP) {
-                    move_forward(0, 0, DEFAULT_TIME);
-                    Sleep(1000); // Wait 1 five seconds
-                    allow_quit = true;
-                } else if ((sonar <= 250) && (now - start_4 < 8500)) {
-                    // printf("Changing angle from %f to ",
-                    // ref_angle_fourth_phase);
-                    ref_angle_fourth_phase = fourth_angle + 12;
-                    // printf("%f\n", ref_angle_fourth_phase);
-                    bypass_back(speed_move_default, ref_angle_fourth_phase,
-                                now - start < 6000);
-                } else if (sonar <= 210) {
-                    stop_motor(sn_clamp);
-                    turn_to(speed_return, fifth_angle, 1);
-                    move_forward(0, 0, DEFAULT_TIME);
-                    open_clamp(speed_clamp, 2000);
-                    Sleep(500);
-                    turn_right_in_place(speed_clamp, 1000);
-                    Sleep(1500);
-                    change_action();
-                    quit = true;
-                }
-            } else if (action == 10) {
-                if (val_sonar <= 100) {
-                    move_straight_for(500, tenth_angle, -speed_move_default);
-                } else if (val_sonar <= 250) {
-                    turn_to(speed_move_default, second_angle, 1);
-                    override_action(2);
-                } else {
-                    move_straight(2 * speed_move_default, DEFAULT_TIME,
-                                  tenth_angle);
-                }
-            }
-        }
+        running = mission_tick(&mission);
     }
 
-    kill(sound_pid, SIGTERM); // Stop the current sound
+    if (sound_pid > 0) {
+        kill(sound_pid, SIGTERM); // Stop the current sound
+    }
     thread_play_sound();      // Play a new sound
 
-    stop_motor(sn_wheel_left);
-    stop_motor(sn_wheel_right);
-    stop_motor(sn_clamp);
-    ev3_uninit();
+    drive_deadman_stop();
+    drive_stop();
+    stop_clamp();
+    sensor_hub_stop();
+    telemetry_close();
+
+    MOTOR_SHADOW_STATS shadow_stats;
+    motor_shadow_get_stats(&shadow_stats);
+    printf("Tacho writes: %lu done, %lu skipped\n", shadow_stats.written,
+           shadow_stats.elided);
+    TICK_STATS tick_stats;
+    tick_get_stats(&tick_stats);
+    long long waited = tick_stats.ticks - tick_stats.misses;
+    printf("Ticks: %lu, %lu missed, jitter mean %lld us max %lld us\n",
+           tick_stats.ticks, tick_stats.misses,
+           waited ? tick_stats.jitter_sum_us / waited : 0,
+           tick_stats.jitter_max_us);
+    instr_dump(stdout);
+    mission_dump(&mission, stdout);
+    ev3_attr_close_all();
     return 0;
 }
@@ -0,0 +1,28 @@
+#include <errno.h>
+#include <time.h>
+
+#include "clock.h"
+
+long long clock_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((long long)ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+long long clock_now_ms(void) { return clock_now_us() / 1000; }
+
+void clock_sleep_ms(int msec) {
+    clock_sleep_until_us(clock_now_us() + (long long)msec * 1000);
+}
+
+bool clock_is_virtual(void) { return false; }
+
+void clock_sleep_until_us(long long deadline_us) {
+    struct timespec ts;
+    ts.tv_sec = deadline_us / 1000000;
+    ts.tv_nsec = (deadline_us % 1000000) * 1000;
+    // Absolute deadline, so being interrupted by a signal does not drift
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+           EINTR) {
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdbool.h>
+
+/*
+ * Time of the program. The tools that run the program on the computer replace
+ * this module by a simulated clock (tools/host.c), so everything that needs
+ * the time or sleeps must go through it.
+ */
+
+/**
+ * @brief Get the time of the monotonic clock
+ *
+ * @return long long the time in microseconds
+ */
+long long clock_now_us(void);
+
+/**
+ * @brief Get the time of the monotonic clock
+ *
+ * @return long long the time in milliseconds
+ */
+long long clock_now_ms(void);
+
+/**
+ * @brief Sleep until the monotonic clock reach a time
+ *
+ * @param deadline_us the time to wake up at, in microseconds
+ */
+void clock_sleep_until_us(long long deadline_us);
+
+/**
+ * @brief Sleep for some time
+ *
+ * @param msec the time in milliseconds
+ */
+void clock_sleep_ms(int msec);
+
+/**
+ * @brief Tell if the clock is simulated
+ * A simulated clock only advances when the program sleeps, the threads of the
+ * program must not be started: the clock calls their polling functions itself.
+ *
+ * @return bool true if the clock is simulated
+ */
+bool clock_is_virtual(void);
+
+#endif /* CLOCK_H */
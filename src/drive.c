@@ -0,0 +1,217 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/ev3.h"
+#include "../include/ev3_tacho.h"
+#include "clock.h"
+#include "drive.h"
+#include "instr.h"
+#include "motor.h"
+#include "tick.h"
+
+#define DEADMAN_PERIOD 10 // Time between two checks of the deadman (ms)
+#define DEADMAN_PRIORITY 55 // In realtime, above a control loop that hangs
+
+enum { WHEEL_LEFT = 0, WHEEL_RIGHT };
+
+// Vector of the two wheels, ended by DESC_LIMIT like in ev3dev-c
+static uint8_t wheels[3] = {DESC_LIMIT, DESC_LIMIT, DESC_LIMIT};
+
+// Continuous mode: the wheels run forever until the deadline is missed
+static pthread_mutex_t drive_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t drive_started = PTHREAD_COND_INITIALIZER;
+static bool continuous = false;
+static long long deadline_us;
+static int command[2] = {0, 0}; // Speeds last commanded
+
+static pthread_t deadman_thread;
+static volatile bool deadman_running = false;
+
+void drive_init(uint8_t sn_left, uint8_t sn_right) {
+    pthread_mutex_lock(&drive_lock); // The deadman may be stopping them
+    wheels[WHEEL_LEFT] = sn_left;
+    wheels[WHEEL_RIGHT] = sn_right;
+    pthread_mutex_unlock(&drive_lock);
+}
+
+/**
+ * @brief Write the setpoints of both wheels, nothing move yet
+ *
+ * @param speed_left the speed of the left wheel
+ * @param speed_right the speed of the right wheel
+ * @return bool false if a write failed
+ */
+static bool drive_stage(int speed_left, int speed_right) {
+    bool ok = true;
+    command[WHEEL_LEFT] = speed_left;
+    command[WHEEL_RIGHT] = speed_right;
+    ok &= motor_set_stop_action(wheels[WHEEL_LEFT], TACHO_COAST);
+    ok &= motor_set_stop_action(wheels[WHEEL_RIGHT], TACHO_COAST);
+    ok &= motor_set_speed_sp(wheels[WHEEL_LEFT], speed_left);
+    ok &= motor_set_speed_sp(wheels[WHEEL_RIGHT], speed_right);
+    for (int i = WHEEL_LEFT; i <= WHEEL_RIGHT; i++) { // Only position mode
+        ok &= motor_set_ramp_up_sp(wheels[i], 0);
+        ok &= motor_set_ramp_down_sp(wheels[i], 0);
+    }
+    return ok;
+}
+
+bool drive_timed(int speed_left, int speed_right, int time) {
+    pthread_mutex_lock(&drive_lock);
+    continuous = false;
+    bool ok = drive_stage(speed_left, speed_right);
+    ok &= motor_set_time_sp(wheels[WHEEL_LEFT], time);
+    ok &= motor_set_time_sp(wheels[WHEEL_RIGHT], time);
+    ok = motor_multi_command(wheels, TACHO_RUN_TIMED) && ok;
+    pthread_mutex_unlock(&drive_lock);
+    return ok;
+}
+
+bool drive_forever(int speed_left, int speed_right) {
+    pthread_mutex_lock(&drive_lock);
+    continuous = false; // No deadman
+    bool ok = drive_stage(speed_left, speed_right);
+    ok = motor_multi_command(wheels, TACHO_RUN_FOREVER) && ok;
+    pthread_mutex_unlock(&drive_lock);
+    return ok;
+}
+
+bool drive_speed(int speed_left, int speed_right, int timeout) {
+    bool ok;
+    pthread_mutex_lock(&drive_lock);
+    deadline_us = clock_now_us() + (long long)timeout * 1000;
+    if (continuous) {
+        // Already running, the shadow skip the wheels whose speed is the same
+        command[WHEEL_LEFT] = speed_left;
+        command[WHEEL_RIGHT] = speed_right;
+        ok = motor_set_speed_sp(wheels[WHEEL_LEFT], speed_left);
+        ok &= motor_set_speed_sp(wheels[WHEEL_RIGHT], speed_right);
+    } else {
+        ok = drive_stage(speed_left, speed_right);
+        ok = motor_multi_command(wheels, TACHO_RUN_FOREVER) && ok;
+        continuous = true;
+        pthread_cond_signal(&drive_started);
+    }
+    pthread_mutex_unlock(&drive_lock);
+    return ok;
+}
+
+bool drive_to_position(int count_left, int count_right, int speed, int ramp) {
+    int count[2] = {count_left, count_right};
+    int most = abs(count_left) > abs(count_right) ? abs(count_left)
+                                                  : abs(count_right);
+    bool ok = true;
+    pthread_mutex_lock(&drive_lock);
+    continuous = false;
+    for (int i = WHEEL_LEFT; i <= WHEEL_RIGHT; i++) {
+        // speed_sp is a magnitude, position_sp gives the direction
+        int sp = most ? (int)((long long)speed * abs(count[i]) / most) : 0;
+        command[i] = (count[i] < 0) ? -sp : sp;
+        ok &= motor_set_stop_action(wheels[i], TACHO_HOLD);
+        ok &= motor_set_speed_sp(wheels[i], sp);
+        ok &= motor_set_position_sp(wheels[i], count[i]);
+        ok &= motor_set_ramp_up_sp(wheels[i], ramp);
+        ok &= motor_set_ramp_down_sp(wheels[i], ramp);
+    }
+    ok = motor_multi_command(wheels, TACHO_RUN_TO_REL_POS) && ok;
+    pthread_mutex_unlock(&drive_lock);
+    return ok;
+}
+
+int drive_position_state(void) {
+    FLAGS_T flags[2];
+    if (!motor_get_state(wheels[WHEEL_LEFT], &flags[WHEEL_LEFT]) ||
+        !motor_get_state(wheels[WHEEL_RIGHT], &flags[WHEEL_RIGHT])) {
+        return DRIVE_ERROR;
+    }
+    if ((flags[WHEEL_LEFT] | flags[WHEEL_RIGHT]) & TACHO_STALLED) {
+        drive_stop();
+        return DRIVE_STALLED;
+    }
+    if ((flags[WHEEL_LEFT] | flags[WHEEL_RIGHT]) & TACHO_RUNNING) {
+        return DRIVE_MOVING;
+    }
+    pthread_mutex_lock(&drive_lock);
+    command[WHEEL_LEFT] = command[WHEEL_RIGHT] = 0;
+    pthread_mutex_unlock(&drive_lock);
+    return DRIVE_DONE;
+}
+
+bool drive_stop(void) {
+    pthread_mutex_lock(&drive_lock);
+    continuous = false;
+    command[WHEEL_LEFT] = command[WHEEL_RIGHT] = 0;
+    bool ok = motor_multi_command(wheels, TACHO_STOP);
+    pthread_mutex_unlock(&drive_lock);
+    return ok;
+}
+
+void drive_get_command(int *speed_left, int *speed_right) {
+    pthread_mutex_lock(&drive_lock);
+    *speed_left = command[WHEEL_LEFT];
+    *speed_right = command[WHEEL_RIGHT];
+    pthread_mutex_unlock(&drive_lock);
+}
+
+bool drive_deadman_check(long long now_us) {
+    bool expired = false;
+    pthread_mutex_lock(&drive_lock);
+    if (continuous && (now_us > deadline_us)) {
+        continuous = false;
+        command[WHEEL_LEFT] = command[WHEEL_RIGHT] = 0;
+        motor_multi_command(wheels, TACHO_STOP);
+        expired = true;
+    }
+    pthread_mutex_unlock(&drive_lock);
+    return expired;
+}
+
+/**
+ * @brief Body of the deadman thread
+ *
+ * @return void* NULL
+ */
+static void *deadman_loop(void *arg) {
+    (void)arg;
+    while (deadman_running) {
+        pthread_mutex_lock(&drive_lock);
+        while (!continuous && deadman_running) { // Nothing to watch
+            pthread_cond_wait(&drive_started, &drive_lock);
+        }
+        pthread_mutex_unlock(&drive_lock);
+
+        long long now = clock_now_us();
+        if (drive_deadman_check(now)) {
+            printf("Deadman: no speed update, wheels stopped\n");
+        }
+        instr_share();
+        clock_sleep_until_us(now + DEADMAN_PERIOD * 1000);
+    }
+    return NULL;
+}
+
+int drive_deadman_start(void) {
+    if (deadman_running || clock_is_virtual()) { // Else the clock polls
+        return 0;
+    }
+    deadman_running = true;
+    if (pthread_create(&deadman_thread, NULL, deadman_loop, NULL)) {
+        deadman_running = false;
+        return 1;
+    }
+    tick_add_thread(deadman_thread, DEADMAN_PRIORITY);
+    return 0;
+}
+
+void drive_deadman_stop(void) {
+    if (!deadman_running) {
+        return;
+    }
+    pthread_mutex_lock(&drive_lock);
+    deadman_running = false;
+    pthread_cond_signal(&drive_started);
+    pthread_mutex_unlock(&drive_lock);
+    tick_remove_thread(deadman_thread);
+    pthread_join(deadman_thread, NULL);
+}
@@ -0,0 +1,129 @@
+#ifndef DRIVE_H
+#define DRIVE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Command the two wheels as a pair: the setpoints of both wheels are written
+ * first, then a single command is fired to both of them back to back, so the
+ * wheels start (and stop) at the same instant.
+ *
+ * In continuous mode (drive_speed) the wheels are started once in run-forever
+ * and only speed_sp is written afterwards. A deadman stops the wheels if the
+ * speed is not updated before its timeout.
+ *
+ * In position mode (drive_to_position) the firmware of the motors runs the
+ * whole move, with its ramps, and the program only polls their state.
+ */
+
+/**
+ * @brief Progress of a move in position mode
+ */
+enum {
+    DRIVE_MOVING = 0,
+    DRIVE_DONE,    // Both wheels reached their position
+    DRIVE_STALLED, // A wheel is blocked, the move was stopped
+    DRIVE_ERROR,   // The state could not be read
+};
+
+/**
+ * @brief Set the two motors driven as a pair
+ * It can be called again by the thread that drives, when a wheel came back
+ * under another sequence number.
+ *
+ * @param sn_left the left wheel
+ * @param sn_right the right wheel
+ */
+void drive_init(uint8_t sn_left, uint8_t sn_right);
+
+/**
+ * @brief Run both wheels at their speed for the same time
+ *
+ * @param speed_left the speed of the left wheel
+ * @param speed_right the speed of the right wheel
+ * @param time the time in milliseconds
+ * @return bool false if a write failed
+ */
+bool drive_timed(int speed_left, int speed_right, int time);
+
+/**
+ * @brief Run both wheels at their speed until told otherwise
+ *
+ * @param speed_left the speed of the left wheel
+ * @param speed_right the speed of the right wheel
+ * @return bool false if a write failed
+ */
+bool drive_forever(int speed_left, int speed_right);
+
+/**
+ * @brief Run both wheels at their speed in continuous mode
+ * The first call start the wheels, the next ones only update the speeds that
+ * changed. If there is no call for timeout ms, the deadman stops the wheels.
+ *
+ * @param speed_left the speed of the left wheel
+ * @param speed_right the speed of the right wheel
+ * @param timeout the time before the deadman stops the wheels (ms)
+ * @return bool false if a write failed
+ */
+bool drive_speed(int speed_left, int speed_right, int timeout);
+
+/**
+ * @brief Turn each wheel by a number of counts, in run-to-rel-pos
+ * The wheels hold their position at the end.
+ *
+ * @param count_left the counts of the left wheel (< 0 to go back)
+ * @param count_right the counts of the right wheel
+ * @param speed the speed of the wheel that turns the most (> 0), the other
+ * one is slower so both end together
+ * @param ramp the time to go from 0 to max_speed and back (ms)
+ * @return bool false if a write failed
+ */
+bool drive_to_position(int count_left, int count_right, int speed, int ramp);
+
+/**
+ * @brief Tell where the move started by drive_to_position is
+ * If a wheel stalled, both are stopped.
+ *
+ * @return int DRIVE_MOVING, DRIVE_DONE, DRIVE_STALLED or DRIVE_ERROR
+ */
+int drive_position_state(void);
+
+/**
+ * @brief Stop both wheels
+ *
+ * @return bool false if a write failed
+ */
+bool drive_stop(void);
+
+/**
+ * @brief Get the speeds last commanded to the wheels (0 once stopped)
+ *
+ * @param speed_left where to store the speed of the left wheel
+ * @param speed_right where to store the speed of the right wheel
+ */
+void drive_get_command(int *speed_left, int *speed_right);
+
+/**
+ * @brief Stop the wheels if the deadline of continuous mode is missed
+ * This is what the deadman thread runs, it can be called directly when the
+ * thread is not started.
+ *
+ * @param now_us the current time in microseconds
+ * @return bool true if the wheels were stopped
+ */
+bool drive_deadman_check(long long now_us);
+
+/**
+ * @brief Start the thread of the deadman
+ *
+ * @return int 0 if the thread was started
+ */
+int drive_deadman_start(void);
+
+/**
+ * @brief Stop the thread of the deadman and wait for it
+ */
+void drive_deadman_stop(void);
+
+#endif /* DRIVE_H */
@@ -0,0 +1,388 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/ev3.h"
+#include "../include/ev3_sensor.h"
+#include "../include/ev3_tacho.h"
+#include "ev3_attr.h"
+#include "instr.h"
+
+typedef struct {
+    const char *name;
+    int flags; // How the file is opened
+} ATTR_DESC;
+
+static const ATTR_DESC attr_desc[EV3_ATTR_COUNT] = {
+    [EV3_ATTR_ADDRESS] = {"address", O_RDONLY},
+    [EV3_ATTR_DRIVER_NAME] = {"driver_name", O_RDONLY},
+
+    [EV3_ATTR_MODE] = {"mode", O_RDWR},
+    [EV3_ATTR_NUM_VALUES] = {"num_values", O_RDONLY},
+    [EV3_ATTR_DECIMALS] = {"decimals", O_RDONLY},
+    [EV3_ATTR_BIN_DATA] = {"bin_data", O_RDONLY},
+    [EV3_ATTR_BIN_DATA_FORMAT] = {"bin_data_format", O_RDONLY},
+    [EV3_ATTR_VALUE0] = {"value0", O_RDONLY},
+    [EV3_ATTR_VALUE1] = {"value1", O_RDONLY},
+    [EV3_ATTR_VALUE2] = {"value2", O_RDONLY},
+    [EV3_ATTR_VALUE3] = {"value3", O_RDONLY},
+    [EV3_ATTR_VALUE4] = {"value4", O_RDONLY},
+    [EV3_ATTR_VALUE5] = {"value5", O_RDONLY},
+    [EV3_ATTR_VALUE6] = {"value6", O_RDONLY},
+    [EV3_ATTR_VALUE7] = {"value7", O_RDONLY},
+
+    [EV3_ATTR_COMMAND] = {"command", O_WRONLY},
+    [EV3_ATTR_COUNT_PER_ROT] = {"count_per_rot", O_RDONLY},
+    [EV3_ATTR_MAX_SPEED] = {"max_speed", O_RDONLY},
+    [EV3_ATTR_POSITION] = {"position", O_RDWR},
+    [EV3_ATTR_POSITION_SP] = {"position_sp", O_RDWR},
+    [EV3_ATTR_RAMP_DOWN_SP] = {"ramp_down_sp", O_RDWR},
+    [EV3_ATTR_RAMP_UP_SP] = {"ramp_up_sp", O_RDWR},
+    [EV3_ATTR_SPEED] = {"speed", O_RDONLY},
+    [EV3_ATTR_SPEED_SP] = {"speed_sp", O_RDWR},
+    [EV3_ATTR_STATE] = {"state", O_RDONLY},
+    [EV3_ATTR_STOP_ACTION] = {"stop_action", O_RDWR},
+    [EV3_ATTR_TIME_SP] = {"time_sp", O_RDWR},
+};
+
+// fd + 1 of every handle, so that 0 means "not opened yet"
+static int attr_fd[EV3_ATTR_CLASS_COUNT][DESC_LIMIT][EV3_ATTR_COUNT];
+static uint32_t attr_generation[EV3_ATTR_CLASS_COUNT][DESC_LIMIT];
+// Accesses in progress on each device, its invalidated fds are closed at 0
+static int attr_users[EV3_ATTR_CLASS_COUNT][DESC_LIMIT];
+// fds taken out of attr_fd by ev3_attr_invalidate, not closed yet. The list
+// grows while the device is never left without an access
+static int *retired_fd[EV3_ATTR_CLASS_COUNT][DESC_LIMIT];
+static int retired_count[EV3_ATTR_CLASS_COUNT][DESC_LIMIT];
+static int retired_size[EV3_ATTR_CLASS_COUNT][DESC_LIMIT];
+// Only taken to open or close a handle, never around the read / write
+static pthread_mutex_t attr_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *class_dir[EV3_ATTR_CLASS_COUNT] = {
+    [EV3_ATTR_SENSOR] = SENSOR_DIR,
+    [EV3_ATTR_TACHO] = TACHO_DIR,
+};
+
+static const char *class_prefix[EV3_ATTR_CLASS_COUNT] = {
+    [EV3_ATTR_SENSOR] = "sensor",
+    [EV3_ATTR_TACHO] = "motor",
+};
+
+const char *ev3_attr_root(void) {
+    static const char *root = NULL;
+    if (!root) { // Same result if two threads do it
+        const char *env = getenv("EV3_SYSFS_ROOT");
+        root = env ? env : "";
+    }
+    return root;
+}
+
+const char *ev3_attr_name(int attr) {
+    if ((attr < 0) || (attr >= EV3_ATTR_COUNT)) {
+        return STR_unknown_;
+    }
+    return attr_desc[attr].name;
+}
+
+/**
+ * @brief Build the path of the file of an attribute
+ *
+ * @param cls the class of the device
+ * @param sn the sequence number of the device
+ * @param attr the attribute
+ * @param path the buffer for the path
+ * @param sz the size of the buffer
+ */
+static void attr_path(int cls, uint8_t sn, int attr, char *path, size_t sz) {
+    snprintf(path, sz, "%s%s/%s%u/%s", ev3_attr_root(), class_dir[cls],
+             class_prefix[cls], sn, attr_desc[attr].name);
+}
+
+/**
+ * @brief Close the fds of a device that were invalidated, attr_lock must be
+ * held and no access be in progress on the device
+ *
+ * @param cls the class of the device
+ * @param sn the sequence number of the device
+ */
+static void attr_close_retired(int cls, uint8_t sn) {
+    for (int i = 0; i < retired_count[cls][sn]; i++) {
+        close(retired_fd[cls][sn][i]);
+    }
+    __atomic_store_n(&retired_count[cls][sn], 0, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Keep an invalidated fd until no access is in progress, attr_lock
+ * must be held
+ *
+ * @param cls the class of the device
+ * @param sn the sequence number of the device
+ * @param fd the file descriptor
+ */
+static void attr_retire(int cls, uint8_t sn, int fd) {
+    int count = retired_count[cls][sn];
+    if (count == retired_size[cls][sn]) {
+        int size = count ? 2 * count : EV3_ATTR_COUNT;
+        int *fds = realloc(retired_fd[cls][sn], size * sizeof(*fds));
+        if (!fds) {
+            return; // Leaked, better than closed in use
+        }
+        retired_fd[cls][sn] = fds;
+        retired_size[cls][sn] = size;
+    }
+    retired_fd[cls][sn][count] = fd;
+    __atomic_store_n(&retired_count[cls][sn], count + 1, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Start an access to a device, its fds stay open until attr_release
+ *
+ * @param cls the class of the device
+ * @param sn the sequence number of the device
+ */
+static void attr_acquire(int cls, uint8_t sn) {
+    // Ordered with the check of ev3_attr_invalidate: either it sees this
+    // access, or the access sees the cleared slots
+    __atomic_add_fetch(&attr_users[cls][sn], 1, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief End an access to a device, the last one closes what was invalidated
+ *
+ * @param cls the class of the device
+ * @param sn the sequence number of the device
+ */
+static void attr_release(int cls, uint8_t sn) {
+    if (__atomic_sub_fetch(&attr_users[cls][sn], 1, __ATOMIC_SEQ_CST) ||
+        !__atomic_load_n(&retired_count[cls][sn], __ATOMIC_SEQ_CST)) {
+        return;
+    }
+    pthread_mutex_lock(&attr_lock);
+    // An access may have started since, and loaded an fd retired after: it
+    // is then closed by its own release. With no access, the ones that start
+    // now only see the slots cleared of the retired fds
+    if (!__atomic_load_n(&attr_users[cls][sn], __ATOMIC_SEQ_CST)) {
+        attr_close_retired(cls, sn);
+    }
+    pthread_mutex_unlock(&attr_lock);
+}
+
+/**
+ * @brief Return the file descriptor of an attribute, open it the first time
+ * The caller must have called attr_acquire on the device.
+ *
+ * @param cls the class of the device
+ * @param sn the sequence number of the device
+ * @param attr the attribute
+ * @return int the file descriptor (< 0 if error)
+ */
+static int attr_get_fd(int cls, uint8_t sn, int attr) {
+    int *slot = &attr_fd[cls][sn][attr];
+    int fd = __atomic_load_n(slot, __ATOMIC_SEQ_CST);
+    if (fd) {
+        return fd - 1; // Hot path, no syscall
+    }
+
+    pthread_mutex_lock(&attr_lock);
+    fd = *slot;
+    if (!fd) { // No one opened it while we were waiting for the lock
+        char path[256];
+        attr_path(cls, sn, attr, path, sizeof(path));
+        int opened = open(path, attr_desc[attr].flags | O_CLOEXEC);
+        if (opened >= 0) {
+            fd = opened + 1;
+            __atomic_store_n(slot, fd, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&attr_lock);
+    return fd - 1;
+}
+
+/**
+ * @brief Check the arguments of an access
+ *
+ * @param cls the class of the device
+ * @param sn the sequence number of the device
+ * @param attr the attribute
+ * @return bool true if they are in range
+ */
+static bool attr_valid(int cls, uint8_t sn, int attr) {
+    return (cls >= 0) && (cls < EV3_ATTR_CLASS_COUNT) && (sn < DESC_LIMIT) &&
+           (attr >= 0) && (attr < EV3_ATTR_COUNT);
+}
+
+/**
+ * @brief Check if an error means the device was unplugged
+ *
+ * @param err the errno
+ * @return bool true if the handles of the device are no longer valid
+ */
+static bool attr_device_gone(int err) {
+    return (err == ENODEV) || (err == ENOENT) || (err == ENXIO) ||
+           (err == EBADF);
+}
+
+size_t ev3_attr_read_binary(int cls, uint8_t sn, int attr, void *buf,
+                            size_t sz) {
+    if (!attr_valid(cls, sn, attr)) {
+        return 0;
+    }
+    attr_acquire(cls, sn);
+    int fd = attr_get_fd(cls, sn, attr);
+    ssize_t n = (fd < 0) ? -1 : pread(fd, buf, sz, 0);
+    int err = errno;
+    if (fd >= 0) {
+        instr_count_read();
+    }
+    if ((n < 0) && (fd >= 0) && attr_device_gone(err)) {
+        ev3_attr_invalidate(cls, sn);
+    }
+    attr_release(cls, sn);
+    return (n < 0) ? 0 : n;
+}
+
+size_t ev3_attr_read(int cls, uint8_t sn, int attr, char *buf, size_t sz) {
+    if (sz == 0) {
+        return 0;
+    }
+    size_t n = ev3_attr_read_binary(cls, sn, attr, buf, sz - 1);
+    buf[n] = '\0';
+    while ((n > 0) && (buf[n - 1] == '\n')) { // sysfs always add a newline
+        buf[--n] = '\0';
+    }
+    return n;
+}
+
+size_t ev3_attr_read_int(int cls, uint8_t sn, int attr, int *value) {
+    char s[32];
+    char *end;
+    if (!ev3_attr_read(cls, sn, attr, s, sizeof(s))) {
+        return 0;
+    }
+    long val = strtol(s, &end, 10);
+    if (end == s) {
+        return 0;
+    }
+    *value = (int)val;
+    return end - s;
+}
+
+size_t ev3_attr_read_float(int cls, uint8_t sn, int attr, float *value) {
+    char s[32];
+    char *end;
+    if (!ev3_attr_read(cls, sn, attr, s, sizeof(s))) {
+        return 0;
+    }
+    float val = strtof(s, &end);
+    if (end == s) {
+        return 0;
+    }
+    *value = val;
+    return end - s;
+}
+
+size_t ev3_attr_write(int cls, uint8_t sn, int attr, const char *value) {
+    if (!attr_valid(cls, sn, attr)) {
+        return 0;
+    }
+    attr_acquire(cls, sn);
+    int fd = attr_get_fd(cls, sn, attr);
+    ssize_t n = (fd < 0) ? -1 : pwrite(fd, value, strlen(value), 0);
+    int err = errno;
+    if (fd >= 0) {
+        instr_count_write();
+    }
+    if ((n < 0) && (fd >= 0) && attr_device_gone(err)) {
+        ev3_attr_invalidate(cls, sn);
+    }
+    // Regular files keep the end of a longer value
+    if ((n >= 0) && *ev3_attr_root() && ftruncate(fd, n)) {
+        n = -1;
+    }
+    attr_release(cls, sn);
+    return (n < 0) ? 0 : n;
+}
+
+size_t ev3_attr_write_int(int cls, uint8_t sn, int attr, int value) {
+    char s[16];
+    snprintf(s, sizeof(s), "%d", value);
+    return ev3_attr_write(cls, sn, attr, s);
+}
+
+bool ev3_attr_search(int cls, int attr, const char *value, uint8_t *sn,
+                     uint8_t from) {
+    if ((cls < 0) || (cls >= EV3_ATTR_CLASS_COUNT)) {
+        return false;
+    }
+    char path[256];
+    snprintf(path, sizeof(path), "%s%s", ev3_attr_root(), class_dir[cls]);
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return false;
+    }
+    size_t len = strlen(class_prefix[cls]);
+    int found = DESC_LIMIT;
+    struct dirent *entry;
+    while ((entry = readdir(dir))) { // Not sorted
+        if (strncmp(entry->d_name, class_prefix[cls], len) != 0) {
+            continue;
+        }
+        char *end;
+        long n = strtol(entry->d_name + len, &end, 10);
+        if ((end == entry->d_name + len) || *end || (n < from) ||
+            (n >= found)) {
+            continue;
+        }
+        char s[64];
+        if (!value || (ev3_attr_read(cls, n, attr, s, sizeof(s)) &&
+                       (strcmp(s, value) == 0))) {
+            found = n;
+        }
+    }
+    closedir(dir);
+    *sn = found;
+    return found < DESC_LIMIT;
+}
+
+void ev3_attr_invalidate(int cls, uint8_t sn) {
+    if ((cls < 0) || (cls >= EV3_ATTR_CLASS_COUNT) || (sn >= DESC_LIMIT)) {
+        return;
+    }
+    pthread_mutex_lock(&attr_lock);
+    for (int attr = 0; attr < EV3_ATTR_COUNT; attr++) {
+        int fd = attr_fd[cls][sn][attr];
+        if (!fd) {
+            continue;
+        }
+        __atomic_store_n(&attr_fd[cls][sn][attr], 0, __ATOMIC_SEQ_CST);
+        // Another thread may be in pread / pwrite on it: the fd is closed
+        // once no access is in progress, so its number is not reused before
+        attr_retire(cls, sn, fd - 1);
+    }
+    if (!__atomic_load_n(&attr_users[cls][sn], __ATOMIC_SEQ_CST)) {
+        attr_close_retired(cls, sn);
+    }
+    __atomic_add_fetch(&attr_generation[cls][sn], 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&attr_lock);
+}
+
+uint32_t ev3_attr_generation(int cls, uint8_t sn) {
+    if ((cls < 0) || (cls >= EV3_ATTR_CLASS_COUNT) || (sn >= DESC_LIMIT)) {
+        return 0;
+    }
+    return __atomic_load_n(&attr_generation[cls][sn], __ATOMIC_ACQUIRE);
+}
+
+void ev3_attr_close_all(void) {
+    for (int cls = 0; cls < EV3_ATTR_CLASS_COUNT; cls++) {
+        for (int sn = 0; sn < DESC_LIMIT; sn++) {
+            ev3_attr_invalidate(cls, sn);
+        }
+    }
+}
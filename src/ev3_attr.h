@@ -0,0 +1,197 @@
+#ifndef EV3_ATTR_H
+#define EV3_ATTR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Persistent handles on the sysfs attributes of the sensors and tachos.
+ *
+ * The ev3dev-c functions (get_sensor_value0, set_tacho_speed_sp, ...) open and
+ * close the attribute file on every call. Here each (device, attribute) file
+ * is opened once, the file descriptor is kept, and every access is a single
+ * pread / pwrite at offset 0.
+ *
+ * The sequence numbers (sn) are the same as the ones of ev3dev-c: sn N is
+ * /sys/class/lego-sensor/sensorN or /sys/class/tacho-motor/motorN.
+ *
+ * When the environment variable EV3_SYSFS_ROOT is set, the tree is looked for
+ * under it (the one made by tools/ev3_simd for example), so the program can
+ * run on a computer.
+ */
+
+/**
+ * @brief Class of the device, select the sysfs directory
+ */
+enum {
+    EV3_ATTR_SENSOR = 0,
+    EV3_ATTR_TACHO,
+
+    EV3_ATTR_CLASS_COUNT,
+};
+
+/**
+ * @brief Attributes that can be accessed through a cached handle
+ */
+enum {
+    // Common
+    EV3_ATTR_ADDRESS = 0,
+    EV3_ATTR_DRIVER_NAME,
+
+    // Sensors
+    EV3_ATTR_MODE,
+    EV3_ATTR_NUM_VALUES,
+    EV3_ATTR_DECIMALS,
+    EV3_ATTR_BIN_DATA,
+    EV3_ATTR_BIN_DATA_FORMAT,
+    EV3_ATTR_VALUE0,
+    EV3_ATTR_VALUE1,
+    EV3_ATTR_VALUE2,
+    EV3_ATTR_VALUE3,
+    EV3_ATTR_VALUE4,
+    EV3_ATTR_VALUE5,
+    EV3_ATTR_VALUE6,
+    EV3_ATTR_VALUE7,
+
+    // Tachos
+    EV3_ATTR_COMMAND,
+    EV3_ATTR_COUNT_PER_ROT,
+    EV3_ATTR_MAX_SPEED,
+    EV3_ATTR_POSITION,
+    EV3_ATTR_POSITION_SP,
+    EV3_ATTR_RAMP_DOWN_SP,
+    EV3_ATTR_RAMP_UP_SP,
+    EV3_ATTR_SPEED,
+    EV3_ATTR_SPEED_SP,
+    EV3_ATTR_STATE,
+    EV3_ATTR_STOP_ACTION,
+    EV3_ATTR_TIME_SP,
+
+    EV3_ATTR_COUNT,
+};
+
+/**
+ * @brief Get the directory the sysfs tree is under
+ *
+ * @return const char* "" on the brick, else the value of EV3_SYSFS_ROOT
+ */
+const char *ev3_attr_root(void);
+
+/**
+ * @brief Find a device by the content of one of its attributes
+ *
+ * @param cls the class of the device
+ * @param attr the attribute to compare (EV3_ATTR_DRIVER_NAME, ...)
+ * @param value the content to look for, NULL for any device
+ * @param sn where to store the sequence number of the device
+ * @param from the first sequence number to consider
+ * @return bool true if a device was found, the one with the lowest sn
+ */
+bool ev3_attr_search(int cls, int attr, const char *value, uint8_t *sn,
+                     uint8_t from);
+
+/**
+ * @brief Get the name of the file of an attribute
+ *
+ * @param attr the attribute
+ * @return const char* the name ("value0", "speed_sp", ...)
+ */
+const char *ev3_attr_name(int attr);
+
+/**
+ * @brief Read the raw content of an attribute, the trailing newline is removed
+ *
+ * @param cls the class of the device
+ * @param sn the sequence number of the device
+ * @param attr the attribute
+ * @param buf the buffer that receive the string
+ * @param sz the size of the buffer
+ * @return size_t the number of bytes read (0 if error)
+ */
+size_t ev3_attr_read(int cls, uint8_t sn, int attr, char *buf, size_t sz);
+
+/**
+ * @brief Read an attribute holding binary data (bin_data)
+ *
+ * @param cls the class of the device
+ * @param sn the sequence number of the device
+ * @param attr the attribute
+ * @param buf the buffer that receive the data
+ * @param sz the size of the buffer
+ * @return size_t the number of bytes read (0 if error)
+ */
+size_t ev3_attr_read_binary(int cls, uint8_t sn, int attr, void *buf,
+                            size_t sz);
+
+/**
+ * @brief Read an attribute as an integer
+ *
+ * @param cls the class of the device
+ * @param sn the sequence number of the device
+ * @param attr the attribute
+ * @param value where to store the value
+ * @return size_t the number of bytes read (0 if error)
+ */
+size_t ev3_attr_read_int(int cls, uint8_t sn, int attr, int *value);
+
+/**
+ * @brief Read an attribute as a float
+ *
+ * @param cls the class of the device
+ * @param sn the sequence number of the device
+ * @param attr the attribute
+ * @param value where to store the value
+ * @return size_t the number of bytes read (0 if error)
+ */
+size_t ev3_attr_read_float(int cls, uint8_t sn, int attr, float *value);
+
+/**
+ * @brief Write a string into an attribute
+ *
+ * @param cls the class of the device
+ * @param sn the sequence number of the device
+ * @param attr the attribute
+ * @param value the string to write
+ * @return size_t the number of bytes written (0 if error)
+ */
+size_t ev3_attr_write(int cls, uint8_t sn, int attr, const char *value);
+
+/**
+ * @brief Write an integer into an attribute
+ *
+ * @param cls the class of the device
+ * @param sn the sequence number of the device
+ * @param attr the attribute
+ * @param value the value to write
+ * @return size_t the number of bytes written (0 if error)
+ */
+size_t ev3_attr_write_int(int cls, uint8_t sn, int attr, int value);
+
+/**
+ * @brief Close every handle of a device, the next access will reopen them
+ * Called automatically when an access fails because the device is gone. A
+ * file another thread is reading or writing is closed once it is done.
+ *
+ * @param cls the class of the device
+ * @param sn the sequence number of the device
+ */
+void ev3_attr_invalidate(int cls, uint8_t sn);
+
+/**
+ * @brief Get the generation of a device
+ * It is incremented each time the handles of the device are invalidated, so
+ * anything resolved for this device can check it is still valid.
+ *
+ * @param cls the class of the device
+ * @param sn the sequence number of the device
+ * @return uint32_t the generation
+ */
+uint32_t ev3_attr_generation(int cls, uint8_t sn);
+
+/**
+ * @brief Close every handle that is open
+ */
+void ev3_attr_close_all(void);
+
+#endif /* EV3_ATTR_H */
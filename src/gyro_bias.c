@@ -0,0 +1,50 @@
+#include <string.h>
+
+#include "gyro_bias.h"
+
+#define QUANTUM_VARIANCE (1.0 / 12) // Of a value rounded to an integer
+
+void gyro_rest_reset(GYRO_REST *r) { memset(r, 0, sizeof(*r)); }
+
+void gyro_rest_add(GYRO_REST *r, float angle, float rate, long long time_us) {
+    if (!r->count) {
+        r->start_us = time_us;
+        r->start_angle = angle;
+    }
+    r->count++;
+    r->last_us = time_us;
+    r->last_angle = angle;
+    r->rate_sum += rate;
+    r->rate_sq += (double)rate * rate;
+}
+
+long long gyro_rest_duration(const GYRO_REST *r) {
+    return r->count ? r->last_us - r->start_us : 0;
+}
+
+bool gyro_bias_add_rest(GYRO_BIAS *b, const GYRO_REST *r) {
+    double t = gyro_rest_duration(r) / 1e6;
+    if ((r->count < 2) || (t <= 0)) {
+        return false;
+    }
+    // Mean of the rates, its variance from the spread of the rates
+    double n = r->count;
+    double mean = r->rate_sum / n;
+    double spread = r->rate_sq / n - mean * mean;
+    double mean_var = ((spread > 0 ? spread : 0) + QUANTUM_VARIANCE) / n;
+    // Slope of the angle, both ends are rounded
+    double slope = (r->last_angle - r->start_angle) / t;
+    double slope_var = 2 * QUANTUM_VARIANCE / (t * t);
+
+    double var = 1 / (1 / mean_var + 1 / slope_var);
+    double bias = var * (mean / mean_var + slope / slope_var);
+    if (b->variance < 0) {
+        b->bias = bias;
+        b->variance = var;
+    } else {
+        double k = b->variance / (b->variance + var);
+        b->bias += k * (bias - b->bias);
+        b->variance = (1 - k) * b->variance;
+    }
+    return true;
+}
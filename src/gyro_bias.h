@@ -0,0 +1,70 @@
+#ifndef GYRO_BIAS_H
+#define GYRO_BIAS_H
+
+#include <stdbool.h>
+
+/*
+ * Estimation of the bias of the gyro (its drift, in degrees / s) while the
+ * robot does not move: the true rate is 0, so the mean of the rates read and
+ * the slope of the angle read are the bias.
+ *
+ * Both are integers on the EV3: the mean of the rates is good when they are
+ * noisy, the slope of the angle when the rest is long. The two are combined
+ * by their variance.
+ */
+
+/**
+ * @brief Samples of the gyro during a rest
+ */
+typedef struct {
+    unsigned long count;
+    long long start_us;
+    long long last_us;
+    float start_angle;
+    float last_angle;
+    double rate_sum;
+    double rate_sq; // Sum of the squares
+} GYRO_REST;
+
+/**
+ * @brief Estimate of the bias
+ */
+typedef struct {
+    float bias;     // degrees / s
+    float variance; // Of bias, < 0 if there is no estimate yet
+} GYRO_BIAS;
+
+/**
+ * @brief Start a rest
+ *
+ * @param r the rest
+ */
+void gyro_rest_reset(GYRO_REST *r);
+
+/**
+ * @brief Add a sample of the gyro to a rest
+ *
+ * @param r the rest
+ * @param angle the angle read (degrees)
+ * @param rate the rate read (degrees / s)
+ * @param time_us when it was read
+ */
+void gyro_rest_add(GYRO_REST *r, float angle, float rate, long long time_us);
+
+/**
+ * @brief Get the duration of a rest
+ *
+ * @return long long the time between its first and last sample (us)
+ */
+long long gyro_rest_duration(const GYRO_REST *r);
+
+/**
+ * @brief Combine the bias measured during a rest with an estimate
+ *
+ * @param b the estimate, updated
+ * @param r the rest, with at least 2 samples
+ * @return bool false if the rest was too short to tell anything
+ */
+bool gyro_bias_add_rest(GYRO_BIAS *b, const GYRO_REST *r);
+
+#endif /* GYRO_BIAS_H */
@@ -0,0 +1,48 @@
+#include <math.h>
+#include <string.h>
+
+#include "heading_pid.h"
+
+#define DT_MAX 0.1f // A longer time since the last update is a new start (s)
+
+float heading_error(float target, float heading) {
+    float error = fmodf(target - heading + 180, 360);
+    if (error < 0) {
+        error += 360;
+    }
+    return error - 180;
+}
+
+void heading_pid_init(HEADING_PID *pid, const HEADING_PID_GAINS *gains) {
+    memset(pid, 0, sizeof(*pid));
+    pid->gains = *gains;
+}
+
+float heading_pid_update(HEADING_PID *pid, float error, float rate,
+                         long long time_us) {
+    const HEADING_PID_GAINS *g = &pid->gains;
+    float dt = pid->valid ? (time_us - pid->time_us) / 1e6f : 0;
+    if ((dt < 0) || (dt > DT_MAX)) {
+        dt = 0;
+        pid->integral = 0;
+    }
+    pid->valid = true;
+    pid->time_us = time_us;
+
+    // The reference does not move, the derivative of the error is -rate
+    float output = g->kp * error - g->kd * rate;
+    float integral = pid->integral + error * dt;
+    float total = output + g->ki * integral;
+    // Anti-windup: do not integrate further into the saturation
+    if ((fabsf(total) <= g->limit) || ((total > 0) != (error > 0))) {
+        pid->integral = integral;
+    }
+    output += g->ki * pid->integral;
+    if (output > g->limit) {
+        return g->limit;
+    }
+    if (output < -g->limit) {
+        return -g->limit;
+    }
+    return output;
+}
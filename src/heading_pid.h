@@ -0,0 +1,65 @@
+#ifndef HEADING_PID_H
+#define HEADING_PID_H
+
+#include <stdbool.h>
+
+/*
+ * PID controller that keeps the heading given by the gyro. Its output is the
+ * part of the base speed added to the left wheel and removed from the right
+ * one, > 0 to turn clockwise (the way the angle of the gyro grows).
+ *
+ * The error is taken on the shortest arc, the derivative is the rate of the
+ * gyro (no kick when the reference changes) and the integral stops growing
+ * while the output is saturated.
+ */
+
+/**
+ * @brief Gains of the controller
+ */
+typedef struct {
+    float kp;     // Per degree of error
+    float ki;     // Per degree * s of error
+    float kd;     // Per degree / s of rate
+    float limit;  // Largest output, 1 stops the inner wheel
+} HEADING_PID_GAINS;
+
+/**
+ * @brief State of the controller
+ */
+typedef struct {
+    HEADING_PID_GAINS gains;
+    bool valid;        // false until the first update
+    long long time_us; // Time of the last update
+    float integral;    // degrees * s
+} HEADING_PID;
+
+/**
+ * @brief Get the error to turn by to go from a heading to a target
+ *
+ * @param target the heading wanted (degrees, not wrapped)
+ * @param heading the heading now (degrees, not wrapped)
+ * @return float the error, in [-180, 180[
+ */
+float heading_error(float target, float heading);
+
+/**
+ * @brief Reset the controller, the integral is lost
+ *
+ * @param pid the controller
+ * @param gains its gains
+ */
+void heading_pid_init(HEADING_PID *pid, const HEADING_PID_GAINS *gains);
+
+/**
+ * @brief Compute the output of the controller
+ *
+ * @param pid the controller
+ * @param error the error, from heading_error
+ * @param rate the rate of the gyro (degrees / s)
+ * @param time_us the time of the sample of the gyro
+ * @return float the output, in [-limit, limit]
+ */
+float heading_pid_update(HEADING_PID *pid, float error, float rate,
+                         long long time_us);
+
+#endif /* HEADING_PID_H */
@@ -0,0 +1,208 @@
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "instr.h"
+
+__thread unsigned long instr_reads = 0;
+__thread unsigned long instr_writes = 0;
+static __thread unsigned long shared_reads = 0;
+static __thread unsigned long shared_writes = 0;
+
+typedef struct {
+    INSTR_HIST tick_us;     // Time worked by each tick
+    INSTR_HIST reads;       // sysfs reads per tick
+    INSTR_HIST writes;      // sysfs writes per tick
+    INSTR_HIST bg_reads;    // By the other threads
+    INSTR_HIST bg_writes;
+} INSTR_PHASE;
+
+static INSTR_PHASE phases[INSTR_MAX_PHASES + 1]; // The last one for the rest
+static int phase_count = INSTR_MAX_PHASES;
+static const char *(*phase_name)(int phase) = NULL;
+// Shared by the other threads, written with atomics
+static unsigned long bg_reads = 0;
+static unsigned long bg_writes = 0;
+static unsigned long last_bg_reads = 0;
+static unsigned long last_bg_writes = 0;
+// Latency of the reads of the sensor hub, written by the hub thread while the
+// main thread dumps it: every field is accessed with atomics
+static INSTR_HIST sensor_us;
+static int phase = 0;
+static unsigned long last_reads = 0;
+static unsigned long last_writes = 0;
+static volatile sig_atomic_t dump_asked = 0;
+
+/**
+ * @brief Get the bucket of a value
+ *
+ * @param value the value
+ * @return int the bucket
+ */
+static int hist_bucket(long long value) {
+    if (value <= 0) {
+        return 0;
+    }
+    int bucket = 64 - __builtin_clzll(value);
+    return (bucket < INSTR_BUCKETS) ? bucket : INSTR_BUCKETS - 1;
+}
+
+void instr_hist_add(INSTR_HIST *hist, long long value) {
+    if (value < 0) {
+        value = 0;
+    }
+    hist->bucket[hist_bucket(value)]++;
+    hist->count++;
+    hist->sum += value;
+    if (value > hist->max) {
+        hist->max = value;
+    }
+}
+
+long long instr_hist_percentile(const INSTR_HIST *hist, double percent) {
+    if (!hist->count) {
+        return 0;
+    }
+    unsigned long rank = (unsigned long)(hist->count * percent / 100);
+    unsigned long seen = 0;
+    for (int i = 0; i < INSTR_BUCKETS; i++) {
+        seen += hist->bucket[i];
+        if (seen > rank) {
+            long long upper = (i == 0) ? 0 : (1LL << i) - 1;
+            return (upper < hist->max) ? upper : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+void instr_share(void) {
+    __atomic_fetch_add(&bg_reads, instr_reads - shared_reads,
+                       __ATOMIC_RELAXED);
+    __atomic_fetch_add(&bg_writes, instr_writes - shared_writes,
+                       __ATOMIC_RELAXED);
+    shared_reads = instr_reads;
+    shared_writes = instr_writes;
+}
+
+void instr_set_phases(int count, const char *(*name)(int phase)) {
+    phase_count = (count < INSTR_MAX_PHASES) ? count : INSTR_MAX_PHASES;
+    phase_name = name;
+}
+
+void instr_set_phase(int new_phase) {
+    if ((new_phase < 0) || (new_phase >= phase_count)) {
+        new_phase = phase_count; // Everything else
+    }
+    phase = new_phase;
+}
+
+void instr_tick(long long work_us) {
+    INSTR_PHASE *p = &phases[phase];
+    unsigned long reads = __atomic_load_n(&bg_reads, __ATOMIC_RELAXED);
+    unsigned long writes = __atomic_load_n(&bg_writes, __ATOMIC_RELAXED);
+    instr_hist_add(&p->tick_us, work_us);
+    instr_hist_add(&p->reads, instr_reads - last_reads);
+    instr_hist_add(&p->writes, instr_writes - last_writes);
+    instr_hist_add(&p->bg_reads, reads - last_bg_reads);
+    instr_hist_add(&p->bg_writes, writes - last_bg_writes);
+    last_reads = instr_reads;
+    last_writes = instr_writes;
+    last_bg_reads = reads;
+    last_bg_writes = writes;
+    if (dump_asked) {
+        dump_asked = 0;
+        instr_dump(stdout);
+    }
+}
+
+void instr_sensor_read(long long latency_us) {
+    if (latency_us < 0) {
+        latency_us = 0;
+    }
+    INSTR_HIST *hist = &sensor_us;
+    __atomic_fetch_add(&hist->bucket[hist_bucket(latency_us)], 1,
+                       __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->sum, latency_us, __ATOMIC_RELAXED);
+    long long max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+    while ((latency_us > max) &&
+           !__atomic_compare_exchange_n(&hist->max, &max, latency_us, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    __atomic_fetch_add(&hist->count, 1, __ATOMIC_RELEASE); // Last
+}
+
+/**
+ * @brief Copy a histogram written by another thread
+ * The copy can be a sample behind in some fields, never torn.
+ *
+ * @param hist the histogram
+ * @param copy where to copy it
+ */
+static void hist_snapshot(INSTR_HIST *hist, INSTR_HIST *copy) {
+    copy->count = __atomic_load_n(&hist->count, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < INSTR_BUCKETS; i++) {
+        copy->bucket[i] = __atomic_load_n(&hist->bucket[i], __ATOMIC_RELAXED);
+    }
+    copy->sum = __atomic_load_n(&hist->sum, __ATOMIC_RELAXED);
+    copy->max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Handler of SIGUSR1, the summary is printed by the next tick
+ *
+ * @param sig the signal
+ */
+static void instr_on_signal(int sig) {
+    (void)sig;
+    dump_asked = 1;
+}
+
+void instr_install_signal(void) {
+    struct sigaction sa = {0};
+    sa.sa_handler = instr_on_signal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, NULL);
+}
+
+/**
+ * @brief Print a line of the summary
+ *
+ * @param out where to print
+ * @param name the name of the histogram
+ * @param hist the histogram
+ */
+static void hist_dump(FILE *out, const char *name, const INSTR_HIST *hist) {
+    double mean = hist->count ? (double)hist->sum / hist->count : 0.0;
+    fprintf(out,
+            "  %-9s n=%-7lu mean=%-8.1f p50<=%-7lld p99<=%-7lld max=%lld\n",
+            name, hist->count, mean, instr_hist_percentile(hist, 50),
+            instr_hist_percentile(hist, 99), hist->max);
+}
+
+void instr_dump(FILE *out) {
+    fprintf(out, "Instrumentation (times in us)\n");
+    for (int i = 0; i <= phase_count; i++) {
+        INSTR_PHASE *p = &phases[i];
+        if (!p->tick_us.count) {
+            continue;
+        }
+        if (i == phase_count) {
+            fprintf(out, "Other actions\n");
+        } else if (phase_name) {
+            fprintf(out, "Action %d (%s)\n", i, phase_name(i));
+        } else {
+            fprintf(out, "Action %d\n", i);
+        }
+        hist_dump(out, "tick", &p->tick_us);
+        hist_dump(out, "reads", &p->reads);
+        hist_dump(out, "writes", &p->writes);
+        hist_dump(out, "bg reads", &p->bg_reads);
+        hist_dump(out, "bg writes", &p->bg_writes);
+    }
+    INSTR_HIST sensor;
+    hist_snapshot(&sensor_us, &sensor);
+    fprintf(out, "Sensor hub\n");
+    hist_dump(out, "read", &sensor);
+    fflush(out);
+}
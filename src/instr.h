@@ -0,0 +1,113 @@
+#ifndef INSTR_H
+#define INSTR_H
+
+#include <stdio.h>
+
+/*
+ * Instrumentation of the control loop, cheap enough to be always on: the
+ * sysfs reads and writes are counted, and the time of each tick, the number
+ * of sysfs accesses per tick and the latency of the sensor reads are put in
+ * log2 histograms, one per phase (action) of the program.
+ * The accesses of the other threads (sensor hub, deadman) are counted apart,
+ * in the tick during which they shared them.
+ * The summary is printed at the end, or on SIGUSR1.
+ */
+
+#define INSTR_BUCKETS 32 // Bucket i holds the values in [2^(i-1), 2^i)
+#define INSTR_MAX_PHASES 32
+
+/**
+ * @brief Histogram of values with log2 buckets
+ */
+typedef struct {
+    unsigned long bucket[INSTR_BUCKETS];
+    unsigned long count;
+    long long sum;
+    long long max;
+} INSTR_HIST;
+
+/**
+ * @brief sysfs accesses done by the current thread
+ */
+extern __thread unsigned long instr_reads;
+extern __thread unsigned long instr_writes;
+
+/**
+ * @brief Count a read of a sysfs attribute
+ */
+static inline void instr_count_read(void) { instr_reads++; }
+
+/**
+ * @brief Count a write of a sysfs attribute
+ */
+static inline void instr_count_write(void) { instr_writes++; }
+
+/**
+ * @brief Add the sysfs accesses of the current thread to the ones of the
+ * other threads, called by the threads that are not the control loop after
+ * their work
+ */
+void instr_share(void);
+
+/**
+ * @brief Add a value to a histogram
+ *
+ * @param hist the histogram
+ * @param value the value (< 0 is counted as 0)
+ */
+void instr_hist_add(INSTR_HIST *hist, long long value);
+
+/**
+ * @brief Get an upper bound of a percentile of a histogram
+ *
+ * @param hist the histogram
+ * @param percent the percentile (50 for the median)
+ * @return long long the upper bound of the bucket holding the percentile
+ */
+long long instr_hist_percentile(const INSTR_HIST *hist, double percent);
+
+/**
+ * @brief Set the phases of the program, before the first tick
+ * Without it there are INSTR_MAX_PHASES of them, printed by their number.
+ *
+ * @param count the number of phases (<= INSTR_MAX_PHASES), the others are
+ * accounted together
+ * @param name gives the name of a phase for the summary, can be NULL
+ */
+void instr_set_phases(int count, const char *(*name)(int phase));
+
+/**
+ * @brief Set the phase the next ticks are accounted to
+ *
+ * @param phase the phase (the action of the program)
+ */
+void instr_set_phase(int phase);
+
+/**
+ * @brief Account a tick of the control loop, called by the scheduler
+ * It also prints the summary if SIGUSR1 was received.
+ *
+ * @param work_us the time the tick worked before waiting for the next one
+ */
+void instr_tick(long long work_us);
+
+/**
+ * @brief Account a read of a sensor
+ *
+ * @param latency_us the time the read took
+ */
+void instr_sensor_read(long long latency_us);
+
+/**
+ * @brief Print the summary on SIGUSR1 (at the next tick)
+ */
+void instr_install_signal(void);
+
+/**
+ * @brief Print the summary of the instrumentation
+ *
+ * @param out where to print
+ */
+void instr_dump(FILE *out);
+
+#endif /* INSTR_H */
@@ -0,0 +1,105 @@
+#include <string.h>
+
+#include "mission.h"
+#include "tick.h"
+
+/**
+ * @brief Leave the current state, its time is recorded
+ *
+ * @param m the state machine
+ */
+static void mission_leave(MISSION *m) {
+    const MISSION_STATE *s = &m->table[m->state];
+    if (s->exit) {
+        s->exit();
+    }
+    MISSION_STATS *stats = &m->stats[m->state];
+    long long spent = tick_time_us() - m->entered_us;
+    stats->time_us += spent;
+    if (s->budget_ms && (spent > s->budget_ms * 1000)) {
+        stats->over++;
+        printf("State %s took %lld ms, over its budget of %lld ms\n",
+               s->name, spent / 1000, s->budget_ms);
+    }
+}
+
+/**
+ * @brief Enter a state
+ *
+ * @param m the state machine
+ * @param state the state
+ */
+static void mission_enter(MISSION *m, int state) {
+    m->state = state;
+    if (state == MISSION_END) {
+        return;
+    }
+    m->stats[state].entries++;
+    m->entered_us = tick_time_us();
+    if (m->table[state].enter) {
+        m->table[state].enter();
+    }
+}
+
+void mission_start(MISSION *m, const MISSION_STATE *table, int count,
+                   int first,
+                   void (*on_change)(int from, int to, const char *reason)) {
+    memset(m, 0, sizeof(*m));
+    m->table = table;
+    m->count = (count < MISSION_MAX_STATES) ? count : MISSION_MAX_STATES;
+    m->on_change = on_change;
+    if (m->on_change) {
+        m->on_change(MISSION_END, first, "start");
+    }
+    mission_enter(m, first);
+}
+
+bool mission_tick(MISSION *m) {
+    if (m->state == MISSION_END) {
+        return false;
+    }
+    const MISSION_STATE *s = &m->table[m->state];
+    for (int i = 0; (i < MISSION_MAX_TRANSITIONS) && s->transition[i].guard;
+         i++) {
+        const MISSION_TRANSITION *t = &s->transition[i];
+        if (!t->guard()) {
+            continue;
+        }
+        int from = m->state;
+        mission_leave(m);
+        if (m->on_change) {
+            m->on_change(from, t->target, t->reason);
+        }
+        mission_enter(m, t->target);
+        return m->state != MISSION_END;
+    }
+    m->stats[m->state].ticks++;
+    if (s->tick) {
+        s->tick();
+    }
+    return true;
+}
+
+long long mission_state_time(const MISSION *m) {
+    return (tick_time_us() - m->entered_us) / 1000;
+}
+
+void mission_dump(const MISSION *m, FILE *out) {
+    fprintf(out, "Mission states (times in ms)\n");
+    for (int i = 0; i < m->count; i++) {
+        const MISSION_STATS *stats = &m->stats[i];
+        if (!stats->entries) {
+            continue;
+        }
+        long long time_us = stats->time_us;
+        if (i == m->state) { // Not left yet
+            time_us += tick_time_us() - m->entered_us;
+        }
+        fprintf(out,
+                "  %-8s entries=%-3lu ticks=%-6lu time=%-7lld budget=%-6lld "
+                "over=%lu\n",
+                m->table[i].name, stats->entries, stats->ticks,
+                time_us / 1000, m->table[i].budget_ms, stats->over);
+    }
+    fflush(out);
+}
@@ -0,0 +1,104 @@
+#ifndef MISSION_H
+#define MISSION_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/*
+ * State machine of the mission, described by a table indexed by the state.
+ * Each tick, the transitions of the current state are tried in order: the
+ * first whose guard is true leaves the state (exit, then enter of the
+ * target), else the tick handler of the state runs.
+ *
+ * The time spent and the ticks run in each state are recorded, and each
+ * state has a time budget so the one eating the match shows in the summary.
+ * The times are the ones of the ticks (tick_time_us), so the guards give the
+ * same result in a replay of the log.
+ */
+
+#define MISSION_MAX_STATES 32
+#define MISSION_MAX_TRANSITIONS 4
+#define MISSION_END -1 // Target of the last transition
+
+/**
+ * @brief A transition, taken when its guard is true
+ */
+typedef struct {
+    bool (*guard)(void); // NULL ends the transitions of the state
+    int target;          // A state, or MISSION_END
+    const char *reason;  // Printed when it is taken
+} MISSION_TRANSITION;
+
+/**
+ * @brief A state, the handlers can be NULL
+ */
+typedef struct {
+    const char *name;
+    void (*enter)(void);
+    void (*tick)(void);
+    void (*exit)(void);
+    long long budget_ms; // Time the state should take at most
+    MISSION_TRANSITION transition[MISSION_MAX_TRANSITIONS];
+} MISSION_STATE;
+
+/**
+ * @brief What was recorded for a state
+ */
+typedef struct {
+    unsigned long entries;
+    unsigned long ticks;
+    long long time_us;    // From the tick it was entered to the one it was left
+    unsigned long over;   // Times it took more than its budget
+} MISSION_STATS;
+
+/**
+ * @brief The state machine
+ */
+typedef struct {
+    const MISSION_STATE *table;
+    int count;
+    int state; // MISSION_END once finished
+    long long entered_us;
+    MISSION_STATS stats[MISSION_MAX_STATES];
+    // Called after each transition, before the enter of the target
+    void (*on_change)(int from, int to, const char *reason);
+} MISSION;
+
+/**
+ * @brief Start the state machine, the first state is entered
+ *
+ * @param m the state machine
+ * @param table the states, indexed by their number
+ * @param count the number of states (<= MISSION_MAX_STATES)
+ * @param first the first state
+ * @param on_change called on each transition, can be NULL
+ */
+void mission_start(MISSION *m, const MISSION_STATE *table, int count,
+                   int first,
+                   void (*on_change)(int from, int to, const char *reason));
+
+/**
+ * @brief Run a tick: take a transition, or run the tick of the state
+ *
+ * @param m the state machine
+ * @return bool false once the mission is finished
+ */
+bool mission_tick(MISSION *m);
+
+/**
+ * @brief Get the time spent in the current state
+ *
+ * @param m the state machine
+ * @return long long the time (ms)
+ */
+long long mission_state_time(const MISSION *m);
+
+/**
+ * @brief Print the time and ticks of each state
+ *
+ * @param m the state machine
+ * @param out where to print
+ */
+void mission_dump(const MISSION *m, FILE *out);
+
+#endif /* MISSION_H */
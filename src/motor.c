@@ -0,0 +1,205 @@
+#include <string.h>
+
+#include "../include/ev3.h"
+#include "../include/ev3_tacho.h"
+#include "ev3_attr.h"
+#include "motor.h"
+
+// The attributes that have a shadow
+enum {
+    SHADOW_SPEED_SP = 0,
+    SHADOW_TIME_SP,
+    SHADOW_POSITION_SP,
+    SHADOW_RAMP_UP_SP,
+    SHADOW_RAMP_DOWN_SP,
+    SHADOW_STOP_ACTION,
+
+    SHADOW_COUNT,
+};
+
+static const int shadow_attr[SHADOW_COUNT] = {
+    [SHADOW_SPEED_SP] = EV3_ATTR_SPEED_SP,
+    [SHADOW_TIME_SP] = EV3_ATTR_TIME_SP,
+    [SHADOW_POSITION_SP] = EV3_ATTR_POSITION_SP,
+    [SHADOW_RAMP_UP_SP] = EV3_ATTR_RAMP_UP_SP,
+    [SHADOW_RAMP_DOWN_SP] = EV3_ATTR_RAMP_DOWN_SP,
+    [SHADOW_STOP_ACTION] = EV3_ATTR_STOP_ACTION,
+};
+
+static const char *const command_name[TACHO_COMMAND__COUNT_] = {
+    [TACHO_RUN_FOREVER] = "run-forever",
+    [TACHO_RUN_TO_ABS_POS] = "run-to-abs-pos",
+    [TACHO_RUN_TO_REL_POS] = "run-to-rel-pos",
+    [TACHO_RUN_TIMED] = "run-timed",
+    [TACHO_RUN_DIRECT] = "run-direct",
+    [TACHO_STOP] = "stop",
+    [TACHO_RESET] = "reset",
+};
+
+static const char *const stop_action_name[TACHO_STOP_ACTION__COUNT_] = {
+    [TACHO_COAST] = "coast",
+    [TACHO_BRAKE] = "brake",
+    [TACHO_HOLD] = "hold",
+};
+
+// Words of the state attribute, bit i is TACHO_RUNNING << i
+static const char *const state_name[] = {"running", "ramping", "holding",
+                                         "overloaded", "stalled"};
+
+typedef struct {
+    uint32_t generation; // Generation of the handles the shadow is valid for
+    uint32_t valid;      // Bit i set if value[i] is what the motor has
+    int value[SHADOW_COUNT];
+} MOTOR_SHADOW;
+
+static MOTOR_SHADOW shadow[DESC_LIMIT];
+static FLAGS_T state_read[DESC_LIMIT]; // Last state read, for the logs
+static MOTOR_SHADOW_STATS shadow_stats;
+
+/**
+ * @brief Write an attribute unless the shadow says it already has this value
+ *
+ * @param sn the motor
+ * @param inx the index of the shadow
+ * @param value the value to write
+ * @param text the text to write (NULL to write value as an integer)
+ * @return bool false if the write failed
+ */
+static bool shadow_write(uint8_t sn, int inx, int value, const char *text) {
+    if (sn >= DESC_LIMIT) {
+        return false;
+    }
+    MOTOR_SHADOW *sh = &shadow[sn];
+    uint32_t generation = ev3_attr_generation(EV3_ATTR_TACHO, sn);
+    if (sh->generation != generation) { // The motor was reconnected
+        sh->generation = generation;
+        sh->valid = 0;
+    }
+    if ((sh->valid & (1u << inx)) && (sh->value[inx] == value)) {
+        __atomic_fetch_add(&shadow_stats.elided, 1, __ATOMIC_RELAXED);
+        return true;
+    }
+
+    size_t written;
+    if (text) {
+        written = ev3_attr_write(EV3_ATTR_TACHO, sn, shadow_attr[inx], text);
+    } else {
+        written = ev3_attr_write_int(EV3_ATTR_TACHO, sn, shadow_attr[inx],
+                                     value);
+    }
+    __atomic_fetch_add(&shadow_stats.written, 1, __ATOMIC_RELAXED);
+    if (!written) {
+        sh->valid &= ~(1u << inx); // We do not know what the motor has now
+        return false;
+    }
+    sh->value[inx] = value;
+    sh->valid |= 1u << inx;
+    return true;
+}
+
+bool motor_set_speed_sp(uint8_t sn, int value) {
+    return shadow_write(sn, SHADOW_SPEED_SP, value, NULL);
+}
+
+bool motor_set_time_sp(uint8_t sn, int value) {
+    return shadow_write(sn, SHADOW_TIME_SP, value, NULL);
+}
+
+bool motor_set_position_sp(uint8_t sn, int value) {
+    return shadow_write(sn, SHADOW_POSITION_SP, value, NULL);
+}
+
+bool motor_set_ramp_up_sp(uint8_t sn, int value) {
+    return shadow_write(sn, SHADOW_RAMP_UP_SP, value, NULL);
+}
+
+bool motor_set_ramp_down_sp(uint8_t sn, int value) {
+    return shadow_write(sn, SHADOW_RAMP_DOWN_SP, value, NULL);
+}
+
+bool motor_set_stop_action(uint8_t sn, INX_T stop_action_inx) {
+    if ((stop_action_inx >= TACHO_STOP_ACTION__COUNT_) ||
+        !stop_action_name[stop_action_inx]) {
+        return false;
+    }
+    return shadow_write(sn, SHADOW_STOP_ACTION, stop_action_inx,
+                        stop_action_name[stop_action_inx]);
+}
+
+bool motor_command(uint8_t sn, INX_T command_inx) {
+    if ((command_inx >= TACHO_COMMAND__COUNT_) || !command_name[command_inx]) {
+        return false;
+    }
+    if (command_inx == TACHO_RESET) { // Every attribute is back to default
+        motor_shadow_invalidate(sn);
+    }
+    __atomic_fetch_add(&shadow_stats.written, 1, __ATOMIC_RELAXED);
+    return ev3_attr_write(EV3_ATTR_TACHO, sn, EV3_ATTR_COMMAND,
+                          command_name[command_inx]) != 0;
+}
+
+bool motor_multi_command(const uint8_t *sn, INX_T command_inx) {
+    bool ok = true;
+    // Nothing else between the writes, so the motors start as close as we can
+    for (; *sn < DESC_LIMIT; sn++) {
+        ok &= motor_command(*sn, command_inx);
+    }
+    return ok;
+}
+
+bool motor_get_state(uint8_t sn, FLAGS_T *flags) {
+    char buf[64];
+    *flags = 0;
+    // Not ev3_attr_read: a stopped motor has an empty state, only "\n"
+    size_t n = ev3_attr_read_binary(EV3_ATTR_TACHO, sn, EV3_ATTR_STATE, buf,
+                                    sizeof(buf) - 1);
+    if (!n || (sn >= DESC_LIMIT)) {
+        return false;
+    }
+    buf[n] = '\0';
+    char *save;
+    for (char *word = strtok_r(buf, " \n", &save); word;
+         word = strtok_r(NULL, " \n", &save)) {
+        for (size_t i = 0; i < sizeof(state_name) / sizeof(state_name[0]);
+             i++) {
+            if (strcmp(word, state_name[i]) == 0) {
+                *flags |= TACHO_RUNNING << i;
+            }
+        }
+    }
+    state_read[sn] = *flags;
+    return true;
+}
+
+FLAGS_T motor_last_state(uint8_t sn) {
+    return (sn < DESC_LIMIT) ? state_read[sn] : 0;
+}
+
+const char *motor_command_name(INX_T command_inx) {
+    if (command_inx >= TACHO_COMMAND__COUNT_) {
+        return NULL;
+    }
+    return command_name[command_inx];
+}
+
+const char *motor_stop_action_name(INX_T stop_action_inx) {
+    if (stop_action_inx >= TACHO_STOP_ACTION__COUNT_) {
+        return NULL;
+    }
+    return stop_action_name[stop_action_inx];
+}
+
+void motor_shadow_invalidate(uint8_t sn) {
+    if (sn < DESC_LIMIT) {
+        shadow[sn].valid = 0;
+    }
+}
+
+void motor_shadow_invalidate_all(void) {
+    memset(shadow, 0, sizeof(shadow));
+}
+
+void motor_shadow_get_stats(MOTOR_SHADOW_STATS *stats) {
+    stats->written = __atomic_load_n(&shadow_stats.written, __ATOMIC_RELAXED);
+    stats->elided = __atomic_load_n(&shadow_stats.elided, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,151 @@
+#ifndef MOTOR_H
+#define MOTOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../include/ev3.h"
+
+/*
+ * Tacho writes with a shadow copy of the last value written to each
+ * attribute of each motor. A write of the value the motor already has is
+ * skipped. The command attribute is never shadowed: writing "run-timed" again
+ * restarts the timer, so it is not a no-op.
+ */
+
+/**
+ * @brief Counters of the writes that went through the shadow
+ */
+typedef struct {
+    unsigned long written; // Writes that reached sysfs
+    unsigned long elided;  // Writes skipped because the value did not change
+} MOTOR_SHADOW_STATS;
+
+/**
+ * @brief Set speed_sp, skipped if it did not change
+ *
+ * @param sn the motor
+ * @param value the speed (tacho counts per second)
+ * @return bool false if the write failed
+ */
+bool motor_set_speed_sp(uint8_t sn, int value);
+
+/**
+ * @brief Set time_sp, skipped if it did not change
+ *
+ * @param sn the motor
+ * @param value the time in milliseconds
+ * @return bool false if the write failed
+ */
+bool motor_set_time_sp(uint8_t sn, int value);
+
+/**
+ * @brief Set position_sp, skipped if it did not change
+ *
+ * @param sn the motor
+ * @param value the position (tacho counts)
+ * @return bool false if the write failed
+ */
+bool motor_set_position_sp(uint8_t sn, int value);
+
+/**
+ * @brief Set ramp_up_sp, skipped if it did not change
+ *
+ * @param sn the motor
+ * @param value the time in milliseconds
+ * @return bool false if the write failed
+ */
+bool motor_set_ramp_up_sp(uint8_t sn, int value);
+
+/**
+ * @brief Set ramp_down_sp, skipped if it did not change
+ *
+ * @param sn the motor
+ * @param value the time in milliseconds
+ * @return bool false if the write failed
+ */
+bool motor_set_ramp_down_sp(uint8_t sn, int value);
+
+/**
+ * @brief Set stop_action, skipped if it did not change
+ *
+ * @param sn the motor
+ * @param stop_action_inx TACHO_COAST, TACHO_BRAKE or TACHO_HOLD
+ * @return bool false if the write failed
+ */
+bool motor_set_stop_action(uint8_t sn, INX_T stop_action_inx);
+
+/**
+ * @brief Send a command to the motor, always written
+ *
+ * @param sn the motor
+ * @param command_inx TACHO_RUN_FOREVER, TACHO_RUN_TIMED, TACHO_STOP, ...
+ * @return bool false if the write failed
+ */
+bool motor_command(uint8_t sn, INX_T command_inx);
+
+/**
+ * @brief Send the same command to several motors, back to back
+ * The vector follows the ev3dev-c convention of multi_set_tacho_command_inx.
+ *
+ * @param sn the motors, ended by DESC_LIMIT
+ * @param command_inx TACHO_RUN_FOREVER, TACHO_RUN_TIMED, TACHO_STOP, ...
+ * @return bool false if one of the writes failed
+ */
+bool motor_multi_command(const uint8_t *sn, INX_T command_inx);
+
+/**
+ * @brief Read the state of the motor
+ *
+ * @param sn the motor
+ * @param flags where to store TACHO_RUNNING, TACHO_RAMPING, TACHO_HOLDING,
+ * TACHO_OVERLOADED and TACHO_STALLED (0 when the motor is stopped)
+ * @return bool false if the read failed
+ */
+bool motor_get_state(uint8_t sn, FLAGS_T *flags);
+
+/**
+ * @brief Get the state of the motor read by the last motor_get_state
+ * For the logs, from the thread that reads it.
+ *
+ * @param sn the motor
+ * @return FLAGS_T the state, 0 if it was never read
+ */
+FLAGS_T motor_last_state(uint8_t sn);
+
+/**
+ * @brief Get the text written to the command attribute for a command
+ *
+ * @param command_inx the command
+ * @return const char* the text ("run-timed", ...), NULL if unknown
+ */
+const char *motor_command_name(INX_T command_inx);
+
+/**
+ * @brief Get the text written to the stop_action attribute
+ *
+ * @param stop_action_inx the stop action
+ * @return const char* the text ("coast", ...), NULL if unknown
+ */
+const char *motor_stop_action_name(INX_T stop_action_inx);
+
+/**
+ * @brief Forget the shadow of a motor, the next writes will all go to sysfs
+ *
+ * @param sn the motor
+ */
+void motor_shadow_invalidate(uint8_t sn);
+
+/**
+ * @brief Forget the shadow of every motor
+ */
+void motor_shadow_invalidate_all(void);
+
+/**
+ * @brief Get the counters of the shadow
+ *
+ * @param stats where to store the counters
+ */
+void motor_shadow_get_stats(MOTOR_SHADOW_STATS *stats);
+
+#endif /* MOTOR_H */
@@ -0,0 +1,70 @@
+#include <math.h>
+#include <string.h>
+
+#include "odometry.h"
+#include "sensor_hub.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static ODOMETRY odometry;
+static double mm_per_count[2];
+static float last_position[2]; // Of the wheels, at the last update
+static float gyro_origin;      // Value of the gyro at odometry_init
+
+/**
+ * @brief Get the last position of the wheels and value of the gyro
+ *
+ * @return bool false if one was never sampled
+ */
+static bool read_samples(float position[2], float *gyro) {
+    HUB_SAMPLE sample;
+    if (!sensor_hub_latest(HUB_GYRO, &sample)) {
+        return false;
+    }
+    *gyro = sample.values.value[0];
+    for (int i = 0; i < 2; i++) {
+        if (!sensor_hub_latest(HUB_WHEEL_LEFT + i, &sample)) {
+            return false;
+        }
+        position[i] = sample.values.value[1];
+    }
+    return true;
+}
+
+bool odometry_init(double mm_per_count_left, double mm_per_count_right) {
+    float gyro;
+    memset(&odometry, 0, sizeof(odometry));
+    mm_per_count[0] = mm_per_count_left;
+    mm_per_count[1] = mm_per_count_right;
+    if (!read_samples(last_position, &gyro)) {
+        return false;
+    }
+    gyro_origin = gyro;
+    return true;
+}
+
+void odometry_update(void) {
+    float position[2];
+    float gyro;
+    if (!read_samples(position, &gyro)) {
+        return;
+    }
+    double left = (position[0] - last_position[0]) * mm_per_count[0];
+    double right = (position[1] - last_position[1]) * mm_per_count[1];
+    last_position[0] = position[0];
+    last_position[1] = position[1];
+
+    double heading = gyro - gyro_origin;
+    double ds = (left + right) / 2;
+    double a = (odometry.heading + heading) / 2 * M_PI / 180; // Middle of it
+    odometry.x += ds * sin(a);
+    odometry.y += ds * cos(a);
+    odometry.heading = heading;
+    odometry.distance += fabs(ds);
+}
+
+void odometry_get(ODOMETRY *o) { *o = odometry; }
+
+double odometry_distance(void) { return odometry.distance; }
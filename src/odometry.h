@@ -0,0 +1,56 @@
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+#include <stdbool.h>
+
+/*
+ * Position of the robot from the last samples of the sensor hub: the distance
+ * comes from the positions of the wheel tachos, the heading from the gyro
+ * (which does not slip like the wheels do in a turn). Updated at every tick
+ * of the control loop.
+ *
+ * x, y are in mm from where the robot was at odometry_init, y along the
+ * heading it had, x to its right. The heading is in degrees, clockwise like
+ * the gyro.
+ */
+
+/**
+ * @brief Estimated position of the robot
+ */
+typedef struct {
+    double x;        // mm
+    double y;        // mm
+    double heading;  // degrees, 0 at odometry_init
+    double distance; // Travelled by the center of the robot, forward or back
+} ODOMETRY;
+
+/**
+ * @brief Start the estimation from here
+ * The hub must have sampled the wheels and the gyro.
+ *
+ * @param mm_per_count_left distance travelled by the left wheel per count
+ * @param mm_per_count_right distance travelled by the right wheel per count
+ * @return bool false if there was no sample of the wheels or of the gyro
+ */
+bool odometry_init(double mm_per_count_left, double mm_per_count_right);
+
+/**
+ * @brief Integrate the samples published since the last update
+ */
+void odometry_update(void);
+
+/**
+ * @brief Get the estimated position
+ *
+ * @param odometry where to store it
+ */
+void odometry_get(ODOMETRY *odometry);
+
+/**
+ * @brief Get the distance travelled since odometry_init
+ *
+ * @return double the distance (mm)
+ */
+double odometry_distance(void);
+
+#endif /* ODOMETRY_H */
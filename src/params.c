@@ -0,0 +1,132 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "params.h"
+
+#define PARAM(field, min, max) {#field, offsetof(PARAMS, field), min, max}
+
+static const PARAM_DESC param_desc[] = {
+    PARAM(speed_move_div, 2, 6),
+    PARAM(speed_clamp_div, 3, 10),
+    PARAM(wall_first, 100, 500),
+    PARAM(wall_second, 100, 400),
+    PARAM(wall_third, 100, 400),
+    PARAM(flag_near, 300, 500),
+    PARAM(flag_far, 450, 700),
+    PARAM(clamp_open, 500, 900),
+    PARAM(return_bypass, 150, 400),
+    PARAM(return_base, 100, 350),
+    PARAM(return_stop, 30, 90),
+    PARAM(aside_wall, 200, 350),
+    PARAM(aside_clear, 250, 400),
+    PARAM(retry_near, 60, 160),
+    PARAM(retry_far, 180, 350),
+    PARAM(obstacle_window, 5000, 15000),
+    PARAM(obstacle_back_min, 3000, 7000),
+    PARAM(obstacle_back_max, 5000, 9000),
+    PARAM(start_wait, 20000, 20000), // Rule of the match
+    PARAM(return_distance, 800, 1900),
+    PARAM(return_back, 3000, 9000),
+    PARAM(heading_kp, 10, 150),
+    PARAM(heading_ki, 0, 100),
+    PARAM(heading_kd, 0, 30),
+};
+
+#define PARAM_COUNT ((int)(sizeof(param_desc) / sizeof(param_desc[0])))
+
+static const PARAMS param_default = {
+    .speed_move_div = 2,
+    .speed_clamp_div = 6,
+    .wall_first = 190,
+    .wall_second = 180,
+    .wall_third = 116,
+    .flag_near = 388,
+    .flag_far = 456,
+    .clamp_open = 540,
+    .return_bypass = 152,
+    .return_base = 169,
+    .return_stop = 56,
+    .aside_wall = 298,
+    .aside_clear = 316,
+    .retry_near = 94,
+    .retry_far = 223,
+    .obstacle_window = 7345,
+    .obstacle_back_min = 3381,
+    .obstacle_back_max = 6958,
+    .start_wait = 20000,
+    .return_distance = 1223,
+    .return_back = 4377,
+    .heading_kp = 113,
+    .heading_ki = 48,
+    .heading_kd = 0,
+};
+
+_Static_assert(sizeof(PARAMS) == PARAM_COUNT * sizeof(int),
+               "every parameter is in param_desc");
+
+PARAMS params = param_default;
+
+int params_count(void) { return PARAM_COUNT; }
+
+const PARAM_DESC *params_desc(int i) {
+    return ((i >= 0) && (i < PARAM_COUNT)) ? &param_desc[i] : NULL;
+}
+
+int *params_value(PARAMS *p, int i) {
+    return (int *)((char *)p + param_desc[i].offset);
+}
+
+void params_default(PARAMS *p) { *p = param_default; }
+
+int params_load(PARAMS *p, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    char line[128];
+    char name[64];
+    int value;
+    int n = 0;
+    int error = 0;
+    while (fgets(line, sizeof(line), f)) {
+        n++;
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        int fields = sscanf(line, "%63s %d", name, &value);
+        if (fields <= 0) {
+            continue; // Empty line
+        }
+        int i = 0;
+        while ((i < PARAM_COUNT) && strcmp(name, param_desc[i].name)) {
+            i++;
+        }
+        if ((fields != 2) || (i == PARAM_COUNT)) {
+            if (!error) {
+                error = n;
+            }
+            continue;
+        }
+        *params_value(p, i) = value;
+    }
+    fclose(f);
+    return error;
+}
+
+int params_init(void) {
+    const char *path = getenv(PARAMS_ENV);
+    if (path && *path) {
+        return params_load(&params, path);
+    }
+    int status = params_load(&params, PARAMS_FILE);
+    return (status == -1) ? 0 : status; // The file is optional
+}
+
+void params_write(const PARAMS *p, FILE *f) {
+    for (int i = 0; i < PARAM_COUNT; i++) {
+        fprintf(f, "%s %d\n", param_desc[i].name,
+                *params_value((PARAMS *)p, i));
+    }
+}
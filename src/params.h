@@ -0,0 +1,116 @@
+#ifndef PARAMS_H
+#define PARAMS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/*
+ * Parameters of the mission: the speeds, the distances of the sonar that end
+ * the phases and the time windows. They have the values tuned on the robot by
+ * default, and can be changed without building again by a file of
+ * "name value" lines (# starts a comment), read at startup.
+ *
+ * tools/tune searches them in the simulated arena and writes such a file.
+ */
+
+#define PARAMS_FILE "params.txt"
+#define PARAMS_ENV "ROBOT_PARAMS" // Path of the file, if not PARAMS_FILE
+
+/**
+ * @brief The parameters, distances in mm, times in ms
+ */
+typedef struct {
+    int speed_move_div;  // Speed to move is max_speed / this
+    int speed_clamp_div; // Speed of the clamp and slow turns
+    int wall_first;      // Phase 1 ends at this distance from the wall
+    int wall_second;     // Phase 2 ends at this distance (or bypasses)
+    int wall_third;      // Phase 3 ends at this distance
+    int flag_near;       // The flag is caught between near and far
+    int flag_far;
+    int clamp_open;      // Open the clamp beyond this distance in phase 3
+    int return_bypass;   // In phase 4, bypass below this distance
+    int return_base;     // In phase 4, the base is below this distance
+    int return_stop;     // In phase 4, stop at or below this distance
+    int aside_wall;      // Bypassing, a wall aside is below this distance
+    int aside_clear;     // Bypassing, the way is clear from this distance
+    int retry_near;      // Turning back after a miss, the wall is found
+    int retry_far;       // between near and far (too close at or below near)
+    int obstacle_window; // In phase 2, a wall before this time is the opponent
+    int obstacle_back_min; // Back off from the opponent met in this window
+    int obstacle_back_max;
+    int start_wait;      // Phase 3 does not start before this time
+    int return_distance; // In phase 4, bypass only before this distance (mm)
+    int return_back;     // Back off before bypassing until this time
+    int heading_kp;      // Gains of the heading controller, in 1/1000
+    int heading_ki;
+    int heading_kd;
+} PARAMS;
+
+/**
+ * @brief Description of a parameter
+ */
+typedef struct {
+    const char *name;
+    size_t offset; // In PARAMS
+    int min;       // Range a search can try, not tuned if min == max
+    int max;
+} PARAM_DESC;
+
+extern PARAMS params;
+
+/**
+ * @brief Get the number of parameters
+ */
+int params_count(void);
+
+/**
+ * @brief Get the description of a parameter
+ *
+ * @param i the parameter, from 0 to params_count() - 1
+ * @return const PARAM_DESC* the description
+ */
+const PARAM_DESC *params_desc(int i);
+
+/**
+ * @brief Access a parameter by its index
+ *
+ * @param p the parameters
+ * @param i the parameter
+ * @return int* where it is stored
+ */
+int *params_value(PARAMS *p, int i);
+
+/**
+ * @brief Set the parameters to their default values
+ *
+ * @param p the parameters
+ */
+void params_default(PARAMS *p);
+
+/**
+ * @brief Read a file of parameters, the ones not in it are not changed
+ *
+ * @param p the parameters
+ * @param path the file
+ * @return int 0 if read, -1 if it can not be opened, else the first line that
+ * could not be understood
+ */
+int params_load(PARAMS *p, const char *path);
+
+/**
+ * @brief Read the parameters of the program: from the file of PARAMS_ENV if
+ * set, else PARAMS_FILE if it exists
+ *
+ * @return int as params_load, 0 if there is no file
+ */
+int params_init(void);
+
+/**
+ * @brief Write all the parameters, in the format read by params_load
+ *
+ * @param p the parameters
+ * @param f where to write them
+ */
+void params_write(const PARAMS *p, FILE *f);
+
+#endif /* PARAMS_H */
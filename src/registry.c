@@ -0,0 +1,61 @@
+#include <pthread.h>
+
+#include "ev3_attr.h"
+#include "registry.h"
+
+static const REGISTRY_ROLE *roles = NULL;
+static int role_count = 0;
+static DEVICE_HANDLE device[REGISTRY_MAX_ROLES];
+static bool found[REGISTRY_MAX_ROLES];
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Search the device of a role, registry_lock must be held
+ *
+ * @param role the role
+ * @return bool true if it was found
+ */
+static bool registry_search(int role) {
+    const REGISTRY_ROLE *r = &roles[role];
+    DEVICE_HANDLE *d = &device[role];
+    d->cls = r->cls;
+    found[role] = ev3_attr_search(r->cls, r->attr, r->value, &d->sn, 0);
+    if (found[role]) {
+        d->generation = ev3_attr_generation(d->cls, d->sn);
+    }
+    return found[role];
+}
+
+int registry_resolve(const REGISTRY_ROLE *new_roles, int count) {
+    if (count > REGISTRY_MAX_ROLES) {
+        count = REGISTRY_MAX_ROLES;
+    }
+    int missing = count;
+    pthread_mutex_lock(&registry_lock);
+    roles = new_roles;
+    role_count = count;
+    for (int i = 0; i < count; i++) {
+        if (!registry_search(i) && (missing == count)) {
+            missing = i;
+        }
+    }
+    pthread_mutex_unlock(&registry_lock);
+    return missing;
+}
+
+bool registry_get(int role, DEVICE_HANDLE *handle) {
+    pthread_mutex_lock(&registry_lock);
+    bool ok = (role >= 0) && (role < role_count);
+    if (ok && !(found[role] && registry_valid(&device[role]))) {
+        ok = registry_search(role); // Gone since the last search
+    }
+    if (ok) {
+        *handle = device[role];
+    }
+    pthread_mutex_unlock(&registry_lock);
+    return ok;
+}
+
+bool registry_valid(const DEVICE_HANDLE *handle) {
+    return ev3_attr_generation(handle->cls, handle->sn) == handle->generation;
+}
@@ -0,0 +1,67 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Devices of the robot by their role (left wheel, sonar, ...). The roles are
+ * searched once at the start, then everything asks the registry and the sysfs
+ * directories are not scanned again.
+ *
+ * A handle keeps the generation of its device in ev3_attr (see
+ * ev3_attr_generation): checking it is a comparison, and a role whose device
+ * was invalidated (unplugged) is searched again the next time it is asked.
+ * The users keep their handles and check them, a device plugged again comes
+ * back under another sn and they must move to it.
+ */
+
+#define REGISTRY_MAX_ROLES 8
+
+/**
+ * @brief How to find the device of a role
+ */
+typedef struct {
+    const char *name;  // For the messages
+    int cls;           // EV3_ATTR_SENSOR or EV3_ATTR_TACHO
+    int attr;          // Attribute to compare, EV3_ATTR_DRIVER_NAME, ...
+    const char *value; // What it must hold
+} REGISTRY_ROLE;
+
+/**
+ * @brief Device of a role
+ */
+typedef struct {
+    int cls;
+    uint8_t sn;
+    uint32_t generation; // Of the device when the handle was taken
+} DEVICE_HANDLE;
+
+/**
+ * @brief Search the device of every role
+ *
+ * @param roles the roles, indexed by their number, kept by the registry
+ * @param count the number of roles (<= REGISTRY_MAX_ROLES)
+ * @return int count if every role was found, else the first one missing
+ */
+int registry_resolve(const REGISTRY_ROLE *roles, int count);
+
+/**
+ * @brief Get the device of a role
+ * The role is searched again only if its device was invalidated.
+ *
+ * @param role the role
+ * @param handle where to store the device
+ * @return bool false if no device has the role
+ */
+bool registry_get(int role, DEVICE_HANDLE *handle);
+
+/**
+ * @brief Tell if the device of a handle is still the same
+ *
+ * @param handle the handle
+ * @return bool true if it can still be used
+ */
+bool registry_valid(const DEVICE_HANDLE *handle);
+
+#endif /* REGISTRY_H */
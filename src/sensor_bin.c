@@ -0,0 +1,154 @@
+#include <string.h>
+
+#include "../include/ev3.h"
+#include "ev3_attr.h"
+#include "sensor_bin.h"
+
+#define BIN_DATA_SIZE 32 // Size of bin_data for all the UART sensors
+
+enum {
+    BIN_NONE = 0, // Layout not read yet
+    BIN_U8,
+    BIN_S8,
+    BIN_U16,
+    BIN_S16,
+    BIN_S16_BE,
+    BIN_S32,
+    BIN_S32_BE,
+    BIN_FLOAT,
+};
+
+static const struct {
+    const char *name;
+    uint8_t size;
+} bin_format[] = {
+    [BIN_U8] = {"u8", 1},
+    [BIN_S8] = {"s8", 1},
+    [BIN_U16] = {"u16", 2},
+    [BIN_S16] = {"s16", 2},
+    [BIN_S16_BE] = {"s16_be", 2},
+    [BIN_S32] = {"s32", 4},
+    [BIN_S32_BE] = {"s32_be", 4},
+    [BIN_FLOAT] = {"float", 4},
+};
+
+#define BIN_FORMAT_COUNT ((int)(sizeof(bin_format) / sizeof(bin_format[0])))
+
+typedef struct {
+    uint32_t generation; // Generation of the handles the layout was read for
+    uint8_t format;
+    uint8_t count;
+    uint8_t decimals;
+} BIN_LAYOUT;
+
+static BIN_LAYOUT layout[DESC_LIMIT];
+
+bool sensor_bin_refresh(uint8_t sn) {
+    if (sn >= DESC_LIMIT) {
+        return false;
+    }
+    BIN_LAYOUT *l = &layout[sn];
+    char s[16];
+    int count;
+    int decimals;
+    l->format = BIN_NONE;
+    l->generation = ev3_attr_generation(EV3_ATTR_SENSOR, sn);
+    if (!ev3_attr_read(EV3_ATTR_SENSOR, sn, EV3_ATTR_BIN_DATA_FORMAT, s,
+                       sizeof(s)) ||
+        !ev3_attr_read_int(EV3_ATTR_SENSOR, sn, EV3_ATTR_NUM_VALUES, &count) ||
+        !ev3_attr_read_int(EV3_ATTR_SENSOR, sn, EV3_ATTR_DECIMALS,
+                           &decimals)) {
+        return false;
+    }
+    for (int f = BIN_U8; f < BIN_FORMAT_COUNT; f++) {
+        if (strcmp(s, bin_format[f].name) == 0) {
+            l->format = f;
+        }
+    }
+    if ((count < 0) || (count > SENSOR_BIN_MAX_VALUES) ||
+        (count * bin_format[l->format].size > BIN_DATA_SIZE)) {
+        l->format = BIN_NONE;
+    }
+    l->count = count;
+    l->decimals = decimals;
+    return l->format != BIN_NONE;
+}
+
+/**
+ * @brief Decode one value of bin_data
+ *
+ * @param format the format of the values
+ * @param p the first byte of the value
+ * @return float the value
+ */
+static float bin_decode(uint8_t format, const uint8_t *p) {
+    switch (format) {
+    case BIN_U8:
+        return p[0];
+    case BIN_S8:
+        return (int8_t)p[0];
+    case BIN_U16: {
+        uint16_t v;
+        memcpy(&v, p, sizeof(v)); // bin_data is little endian, like the brick
+        return v;
+    }
+    case BIN_S16: {
+        int16_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    case BIN_S16_BE:
+        return (int16_t)((p[0] << 8) | p[1]);
+    case BIN_S32: {
+        int32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    case BIN_S32_BE:
+        return (int32_t)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                         ((uint32_t)p[2] << 8) | p[3]);
+    case BIN_FLOAT: {
+        float v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    }
+    return 0;
+}
+
+size_t sensor_bin_read(uint8_t sn, SENSOR_VALUES *values) {
+    if (sn >= DESC_LIMIT) {
+        return 0;
+    }
+    BIN_LAYOUT *l = &layout[sn];
+    if ((l->format == BIN_NONE) ||
+        (l->generation != ev3_attr_generation(EV3_ATTR_SENSOR, sn))) {
+        if (!sensor_bin_refresh(sn)) {
+            return 0;
+        }
+    }
+
+    uint8_t buf[BIN_DATA_SIZE];
+    size_t size = l->count * bin_format[l->format].size;
+    size_t n = ev3_attr_read_binary(EV3_ATTR_SENSOR, sn, EV3_ATTR_BIN_DATA,
+                                    buf, sizeof(buf));
+    if (n && (n != size)) {
+        // bin_data holds exactly the values of the mode: it changed since
+        // the layout was read (a mode applied later than written, as the
+        // simulator does), the layout is read again
+        if (!sensor_bin_refresh(sn)) {
+            return 0;
+        }
+        size = l->count * bin_format[l->format].size;
+    }
+    if (n < size) {
+        return 0;
+    }
+    for (int i = 0; i < l->count; i++) {
+        values->value[i] =
+            bin_decode(l->format, buf + i * bin_format[l->format].size);
+    }
+    values->count = l->count;
+    values->decimals = l->decimals;
+    return l->count;
+}
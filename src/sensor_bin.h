@@ -0,0 +1,43 @@
+#ifndef SENSOR_BIN_H
+#define SENSOR_BIN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Read every value of the current mode of a sensor at once from bin_data,
+ * instead of one text read and one strtof per valueN. The layout of bin_data
+ * (bin_data_format, num_values, decimals) is read once and kept until the
+ * mode changes, which a read of bin_data of another size also reveals.
+ */
+
+#define SENSOR_BIN_MAX_VALUES 8
+
+/**
+ * @brief All the values of a sensor, as the raw integers of value0..N
+ */
+typedef struct {
+    uint8_t count;    // Number of values of the mode
+    uint8_t decimals; // Number of decimal places of the values
+    float value[SENSOR_BIN_MAX_VALUES];
+} SENSOR_VALUES;
+
+/**
+ * @brief Read the layout of bin_data again, to call after changing the mode
+ *
+ * @param sn the sensor
+ * @return bool false if the layout could not be read or is not supported
+ */
+bool sensor_bin_refresh(uint8_t sn);
+
+/**
+ * @brief Read all the values of a sensor with a single read
+ *
+ * @param sn the sensor
+ * @param values where to store the values
+ * @return size_t the number of values decoded (0 if error)
+ */
+size_t sensor_bin_read(uint8_t sn, SENSOR_VALUES *values);
+
+#endif /* SENSOR_BIN_H */
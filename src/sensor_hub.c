@@ -0,0 +1,294 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "clock.h"
+#include "ev3_attr.h"
+#include "gyro_bias.h"
+#include "instr.h"
+#include "sensor_bin.h"
+#include "sensor_hub.h"
+#include "tick.h"
+
+#define REST_SETTLE_US 300000 // Wheels still this long before a rest starts
+#define REST_MIN_US 500000    // Shorter rests are not used
+#define REST_RATE 3.0f        // A rest is over above this rate (degrees / s)
+#define BIAS_PRIOR_SD 0.1f    // Of the bias before any rest (degrees / s)
+#define HUB_PRIORITY 45       // In realtime, below the control loop
+
+typedef struct {
+    uint8_t sn;
+    long long period_us; // 0 if the slot is not used
+    long long next_us;   // When the next sample is due
+
+    uint32_t seq; // Odd while the sample is being written
+    HUB_SAMPLE sample;
+} HUB_SLOT;
+
+static HUB_SLOT slots[HUB_SENSOR_COUNT];
+static pthread_t hub_thread;
+static volatile bool hub_running = false;
+
+// Bias of the gyro, only the hub writes them
+static GYRO_BIAS gyro_bias = {0, BIAS_PRIOR_SD * BIAS_PRIOR_SD};
+static GYRO_REST gyro_rest;
+static long long gyro_still_us = -1; // Since when the wheels are still
+static long long gyro_last_us = -1;  // Time of the last sample of the gyro
+static float gyro_offset;            // Drift removed from the angle so far
+static float gyro_bias_published;
+static uint32_t gyro_rests;    // Number of rests used
+static bool gyro_fold_request; // Use the current rest now
+
+void sensor_hub_configure(int id, uint8_t sn, int period_ms) {
+    if ((id < 0) || (id >= HUB_SENSOR_COUNT)) {
+        return;
+    }
+    slots[id].sn = sn;
+    slots[id].period_us = (period_ms > 0) ? (long long)period_ms * 1000 : 0;
+    slots[id].next_us = 0;
+    if ((period_ms > 0) && (id < HUB_WHEEL_LEFT)) {
+        sensor_bin_refresh(sn);
+    }
+}
+
+void sensor_hub_set_device(int id, uint8_t sn) {
+    if ((id < 0) || (id >= HUB_SENSOR_COUNT)) {
+        return;
+    }
+    // sensor_bin reads the layout of a new sensor on its first read
+    __atomic_store_n(&slots[id].sn, sn, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Read the values of a slot
+ *
+ * @param id the slot
+ * @param values where to store the values
+ * @return bool false if the read failed
+ */
+static bool hub_read(int id, SENSOR_VALUES *values) {
+    uint8_t sn = __atomic_load_n(&slots[id].sn, __ATOMIC_RELAXED);
+    if (id < HUB_WHEEL_LEFT) {
+        return sensor_bin_read(sn, values) != 0;
+    }
+    int speed;
+    int position;
+    if (!ev3_attr_read_int(EV3_ATTR_TACHO, sn, EV3_ATTR_SPEED, &speed) ||
+        !ev3_attr_read_int(EV3_ATTR_TACHO, sn, EV3_ATTR_POSITION,
+                           &position)) {
+        return false;
+    }
+    values->count = 2;
+    values->decimals = 0;
+    values->value[0] = speed;
+    values->value[1] = position;
+    return true;
+}
+
+/**
+ * @brief Publish a new sample of a slot
+ *
+ * @param slot the slot
+ * @param values the values read
+ * @param time_us when the values were read
+ */
+static void hub_publish(HUB_SLOT *slot, const SENSOR_VALUES *values,
+                        long long time_us) {
+    // Seqlock write side, the only writer is the hub
+    __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->sample.time_us = time_us;
+    slot->sample.values = *values;
+    slot->sample.count++;
+    __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+}
+
+void sensor_hub_publish(int id, const SENSOR_VALUES *values,
+                        long long time_us) {
+    if ((id < 0) || (id >= HUB_SENSOR_COUNT)) {
+        return;
+    }
+    slots[id].period_us = 0; // The caller gives the samples from now on
+    hub_publish(&slots[id], values, time_us);
+}
+
+/**
+ * @brief Tell if the encoders of both wheels say the robot does not turn
+ *
+ * @param time_us the time of the gyro sample
+ * @return bool true if both wheels are still
+ */
+static bool hub_wheels_still(long long time_us) {
+    for (int id = HUB_WHEEL_LEFT; id <= HUB_WHEEL_RIGHT; id++) {
+        const HUB_SAMPLE *sample = &slots[id].sample; // We are the writer
+        if (!slots[id].period_us || !sample->count ||
+            (time_us - sample->time_us > 2 * slots[id].period_us) ||
+            (sample->values.value[0] != 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Use the current rest in the estimate of the bias
+ */
+static void hub_gyro_fold(void) {
+    if ((gyro_rest_duration(&gyro_rest) >= REST_MIN_US) &&
+        gyro_bias_add_rest(&gyro_bias, &gyro_rest)) {
+        __atomic_store(&gyro_bias_published, &gyro_bias.bias,
+                       __ATOMIC_RELAXED);
+        __atomic_add_fetch(&gyro_rests, 1, __ATOMIC_RELEASE);
+    }
+    gyro_rest_reset(&gyro_rest);
+}
+
+/**
+ * @brief Estimate the bias of the gyro and remove it from a sample
+ * The angle and rate of GYRO-G&A are corrected, other modes are not.
+ *
+ * @param values the values read, corrected in place
+ * @param time_us when they were read
+ */
+static void hub_gyro_correct(SENSOR_VALUES *values, long long time_us) {
+    if (values->count < 2) {
+        return;
+    }
+    float angle = values->value[0];
+    float rate = values->value[1];
+    float bias = gyro_bias.bias;
+
+    // The encoders cross check the gyro: no yaw while the wheels are still
+    if (hub_wheels_still(time_us) && (fabsf(rate - bias) <= REST_RATE)) {
+        if (gyro_still_us < 0) {
+            gyro_still_us = time_us;
+        }
+        if (time_us - gyro_still_us >= REST_SETTLE_US) {
+            gyro_rest_add(&gyro_rest, angle, rate, time_us);
+        }
+    } else {
+        gyro_still_us = -1;
+        hub_gyro_fold();
+    }
+    if (__atomic_exchange_n(&gyro_fold_request, false, __ATOMIC_ACQUIRE)) {
+        hub_gyro_fold();
+    }
+
+    // The bias only changes the drift from now on, the angle does not jump
+    if (gyro_last_us >= 0) {
+        gyro_offset += bias * (time_us - gyro_last_us) / 1e6f;
+    }
+    gyro_last_us = time_us;
+    values->value[0] = angle - gyro_offset;
+    values->value[1] = rate - gyro_bias.bias;
+}
+
+long long sensor_hub_poll(long long now_us) {
+    long long next = now_us + 1000000;
+    for (int id = 0; id < HUB_SENSOR_COUNT; id++) {
+        HUB_SLOT *slot = &slots[id];
+        if (!slot->period_us) {
+            continue;
+        }
+        if (slot->next_us <= now_us) {
+            SENSOR_VALUES values = {0}; // Past count, nothing is published
+            long long before = clock_now_us();
+            if (hub_read(id, &values)) {
+                long long after = clock_now_us();
+                instr_sensor_read(after - before);
+                if (id == HUB_GYRO) {
+                    hub_gyro_correct(&values, after);
+                }
+                hub_publish(slot, &values, after);
+            }
+            slot->next_us += slot->period_us;
+            if (slot->next_us <= now_us) { // We are late, do not catch up
+                slot->next_us = now_us + slot->period_us;
+            }
+        }
+        if (slot->next_us < next) {
+            next = slot->next_us;
+        }
+    }
+    return next;
+}
+
+bool sensor_hub_latest(int id, HUB_SAMPLE *sample) {
+    if ((id < 0) || (id >= HUB_SENSOR_COUNT)) {
+        return false;
+    }
+    HUB_SLOT *slot = &slots[id];
+    uint32_t before;
+    uint32_t after;
+    do {
+        before = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        *sample = slot->sample;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+    } while ((before & 1) || (before != after)); // Written while we copied
+    return sample->count != 0;
+}
+
+bool sensor_hub_gyro_calibrate(int duration_ms) {
+    uint32_t before = __atomic_load_n(&gyro_rests, __ATOMIC_ACQUIRE);
+    clock_sleep_ms(REST_SETTLE_US / 1000 + duration_ms);
+    __atomic_store_n(&gyro_fold_request, true, __ATOMIC_RELEASE);
+    for (int i = 0; i < 10; i++) { // Wait for the next sample of the gyro
+        if (__atomic_load_n(&gyro_rests, __ATOMIC_ACQUIRE) != before) {
+            return true;
+        }
+        clock_sleep_ms(slots[HUB_GYRO].period_us / 1000 + 1);
+    }
+    return false;
+}
+
+float sensor_hub_gyro_bias(void) {
+    float bias;
+    __atomic_load(&gyro_bias_published, &bias, __ATOMIC_RELAXED);
+    return bias;
+}
+
+/**
+ * @brief Body of the thread of the hub
+ *
+ * @return void* NULL
+ */
+static void *hub_loop(void *arg) {
+    (void)arg;
+    while (hub_running) {
+        long long next = sensor_hub_poll(clock_now_us());
+        instr_share(); // Shown in the tick summary of the control loop
+        clock_sleep_until_us(next);
+    }
+    return NULL;
+}
+
+int sensor_hub_start(void) {
+    if (hub_running) {
+        return 0;
+    }
+    long long now = clock_now_us();
+    for (int id = 0; id < HUB_SENSOR_COUNT; id++) {
+        slots[id].next_us = now;
+    }
+    sensor_hub_poll(now); // So there is a sample as soon as we return
+    if (clock_is_virtual()) { // The clock polls the hub
+        return 0;
+    }
+    hub_running = true;
+    if (pthread_create(&hub_thread, NULL, hub_loop, NULL)) {
+        hub_running = false;
+        return 1;
+    }
+    tick_add_thread(hub_thread, HUB_PRIORITY);
+    return 0;
+}
+
+void sensor_hub_stop(void) {
+    if (!hub_running) {
+        return;
+    }
+    hub_running = false;
+    tick_remove_thread(hub_thread);
+    pthread_join(hub_thread, NULL);
+}
@@ -0,0 +1,122 @@
+#ifndef SENSOR_HUB_H
+#define SENSOR_HUB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sensor_bin.h"
+
+/*
+ * A thread samples the sensors at their own rate and publishes the last sample
+ * of each one through a seqlock. Reading a sample is a copy from memory, no
+ * syscall is done by the reader.
+ *
+ * The hub also removes the bias of the gyro from its angle and rate. The bias
+ * is estimated each time the encoders say the robot is still, so every reader
+ * of the gyro gets the corrected values.
+ */
+
+/**
+ * @brief The sensors sampled by the hub
+ */
+enum {
+    HUB_SONAR = 0,
+    HUB_GYRO,
+    HUB_COLOR,
+    HUB_WHEEL_LEFT, // Tachos: value[0] is the speed, value[1] the position
+    HUB_WHEEL_RIGHT,
+
+    HUB_SENSOR_COUNT,
+};
+
+/**
+ * @brief A sample of a sensor
+ */
+typedef struct {
+    long long time_us;    // When the sample was read (monotonic clock)
+    uint32_t count;       // Number of samples published so far, 0 if none
+    SENSOR_VALUES values; // Every value of the mode, read from bin_data
+} HUB_SAMPLE;
+
+/**
+ * @brief Set the sensor used for a slot of the hub
+ * The mode of the sensor must be set before, it is not checked again once the
+ * hub is started.
+ *
+ * @param id HUB_SONAR, HUB_GYRO, HUB_COLOR, HUB_WHEEL_LEFT or HUB_WHEEL_RIGHT
+ * @param sn the sensor (or the tacho for the wheels)
+ * @param period_ms the time between two samples (<= 0 to disable)
+ */
+void sensor_hub_configure(int id, uint8_t sn, int period_ms);
+
+/**
+ * @brief Change the device of a slot, the hub can be running
+ * For a device plugged again, that came back under another sequence number.
+ * The mode of a sensor must be set before.
+ *
+ * @param id the slot
+ * @param sn the new sensor (or tacho)
+ */
+void sensor_hub_set_device(int id, uint8_t sn);
+
+/**
+ * @brief Publish a sample that was not read by the hub, for tools/replay
+ * The values are published as they are, the bias of the gyro is not removed.
+ * The hub no longer samples the slot: the caller gives its samples from now
+ * on. Only when the hub is polled, not started.
+ *
+ * @param id the slot
+ * @param values the values
+ * @param time_us when they were read
+ */
+void sensor_hub_publish(int id, const SENSOR_VALUES *values, long long time_us);
+
+/**
+ * @brief Start the thread that samples the sensors
+ *
+ * @return int 0 if the thread was started
+ */
+int sensor_hub_start(void);
+
+/**
+ * @brief Stop the thread and wait for it
+ */
+void sensor_hub_stop(void);
+
+/**
+ * @brief Read every sensor whose period has elapsed
+ * This is what the thread runs, it can be called directly when the hub is not
+ * started.
+ *
+ * @param now_us the current time in microseconds
+ * @return long long the time the next sensor is due at
+ */
+long long sensor_hub_poll(long long now_us);
+
+/**
+ * @brief Get the last sample of a sensor
+ *
+ * @param id the slot of the hub
+ * @param sample where to copy the sample
+ * @return bool false if the sensor was never sampled
+ */
+bool sensor_hub_latest(int id, HUB_SAMPLE *sample);
+
+/**
+ * @brief Estimate the bias of the gyro while the robot does not move
+ * The wheels must be still and the gyro in GYRO-G&A. The estimate is then kept
+ * up to date on every later rest of the robot.
+ *
+ * @param duration_ms how long to measure, once the wheels are settled
+ * @return bool false if the robot moved, or the gyro is not sampled
+ */
+bool sensor_hub_gyro_calibrate(int duration_ms);
+
+/**
+ * @brief Get the bias removed from the gyro
+ *
+ * @return float the bias (degrees / s), 0 until it is estimated
+ */
+float sensor_hub_gyro_bias(void);
+
+#endif /* SENSOR_HUB_H */
@@ -0,0 +1,83 @@
+#include <string.h>
+
+#include "sonar_filter.h"
+
+#define NOISE_SD 10.0f     // Of a sample (mm)
+#define ACCEL_SD 1500.0f   // Of the change of the rate (mm / s^2)
+#define GATE 4.0f          // Samples further than this many sd are rejected
+#define RATE_SD_START 500.0f // Of the rate after a (re)start (mm / s)
+#define PREDICT_MAX 0.1f   // Predict at most this long after a sample (s)
+
+void sonar_filter_init(SONAR_FILTER *f) { memset(f, 0, sizeof(*f)); }
+
+/**
+ * @brief Start the filter from a sample
+ */
+static void restart(SONAR_FILTER *f, float distance, long long time_us) {
+    f->valid = true;
+    f->time_us = time_us;
+    f->distance = distance;
+    f->rate = 0;
+    f->p[0][0] = NOISE_SD * NOISE_SD;
+    f->p[0][1] = f->p[1][0] = 0;
+    f->p[1][1] = RATE_SD_START * RATE_SD_START;
+    f->rejected = 0;
+}
+
+bool sonar_filter_update(SONAR_FILTER *f, float distance, long long time_us) {
+    if (!f->valid) {
+        if (distance >= SONAR_FILTER_NOTHING) {
+            return false;
+        }
+        restart(f, distance, time_us);
+        return true;
+    }
+
+    // Predict to the time of the sample
+    float dt = (time_us - f->time_us) / 1e6f;
+    if (dt < 0) {
+        dt = 0;
+    }
+    float d = f->distance + f->rate * dt;
+    float q = ACCEL_SD * ACCEL_SD;
+    float p00 = f->p[0][0] + dt * (f->p[0][1] + f->p[1][0]) +
+                dt * dt * f->p[1][1] + q * dt * dt * dt * dt / 4;
+    float p01 = f->p[0][1] + dt * f->p[1][1] + q * dt * dt * dt / 2;
+    float p11 = f->p[1][1] + q * dt * dt;
+
+    // Gate the sample on its innovation
+    float innovation = distance - d;
+    float s = p00 + NOISE_SD * NOISE_SD;
+    if ((distance >= SONAR_FILTER_NOTHING) ||
+        (innovation * innovation > GATE * GATE * s)) {
+        f->rejected_total++;
+        if (++f->rejected >= SONAR_FILTER_REJECTS) {
+            restart(f, distance, time_us);
+            return true;
+        }
+        return false;
+    }
+
+    // Correct
+    float k0 = p00 / s;
+    float k1 = p01 / s;
+    f->time_us = time_us;
+    f->distance = d + k0 * innovation;
+    f->rate += k1 * innovation;
+    f->p[0][0] = (1 - k0) * p00;
+    f->p[0][1] = f->p[1][0] = (1 - k0) * p01;
+    f->p[1][1] = p11 - k1 * p01;
+    f->rejected = 0;
+    return true;
+}
+
+float sonar_filter_predict(const SONAR_FILTER *f, long long time_us) {
+    if (!f->valid) {
+        return -1;
+    }
+    float dt = (time_us - f->time_us) / 1e6f;
+    if (dt > PREDICT_MAX) { // The rate is too old to go further
+        dt = PREDICT_MAX;
+    }
+    return f->distance + f->rate * ((dt > 0) ? dt : 0);
+}
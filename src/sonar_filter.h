@@ -0,0 +1,59 @@
+#ifndef SONAR_FILTER_H
+#define SONAR_FILTER_H
+
+#include <stdbool.h>
+
+/*
+ * Kalman filter of the distance given by the sonar, with a constant velocity
+ * model: it estimates the distance and the rate it changes at (< 0 when
+ * getting closer), at the time of each sample, and can predict them at a
+ * later time so the estimate has no lag.
+ *
+ * A sample too far from the prediction (an echo of something else, or
+ * SONAR_FILTER_NOTHING) is rejected. After SONAR_FILTER_REJECTS in a row, the
+ * scene changed (the robot turned) and the filter restarts from the sample.
+ */
+
+#define SONAR_FILTER_NOTHING 2550 // What the sonar returns without an echo
+#define SONAR_FILTER_REJECTS 5
+
+/**
+ * @brief State of the filter
+ */
+typedef struct {
+    bool valid;        // false until the first sample
+    long long time_us; // Time of the last sample used
+    float distance;    // mm, at time_us
+    float rate;        // mm / s
+    float p[2][2];     // Covariance of (distance, rate)
+    int rejected;      // Samples rejected in a row
+    unsigned long rejected_total;
+} SONAR_FILTER;
+
+/**
+ * @brief Reset the filter
+ *
+ * @param f the filter
+ */
+void sonar_filter_init(SONAR_FILTER *f);
+
+/**
+ * @brief Give a new sample to the filter
+ *
+ * @param f the filter
+ * @param distance the distance read (mm)
+ * @param time_us when it was read
+ * @return bool false if the sample was rejected
+ */
+bool sonar_filter_update(SONAR_FILTER *f, float distance, long long time_us);
+
+/**
+ * @brief Get the distance the filter expects at a time
+ *
+ * @param f the filter
+ * @param time_us the time, after the last sample
+ * @return float the distance (mm), -1 if there was no sample yet
+ */
+float sonar_filter_predict(const SONAR_FILTER *f, long long time_us);
+
+#endif /* SONAR_FILTER_H */
@@ -0,0 +1,25 @@
+#include <math.h>
+
+#include "sprt.h"
+
+void sprt_init(SPRT *t, float p_accept, float p_reject, float alpha,
+               float beta) {
+    t->hit = logf(p_accept / p_reject);
+    t->miss = logf((1 - p_accept) / (1 - p_reject));
+    t->upper = logf((1 - beta) / alpha);
+    t->lower = logf(beta / (1 - alpha));
+    t->llr = 0;
+    t->count = 0;
+}
+
+int sprt_add(SPRT *t, bool hit) {
+    t->llr += hit ? t->hit : t->miss;
+    t->count++;
+    if (t->llr >= t->upper) {
+        return SPRT_ACCEPT;
+    }
+    if (t->llr <= t->lower) {
+        return SPRT_REJECT;
+    }
+    return SPRT_CONTINUE;
+}
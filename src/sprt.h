@@ -0,0 +1,55 @@
+#ifndef SPRT_H
+#define SPRT_H
+
+#include <stdbool.h>
+
+/*
+ * Sequential probability ratio test on samples that hit or miss, as the reads
+ * of the color sensor that see the flag or not. The log of the likelihood
+ * ratio of the two hypotheses is summed over the samples, and the test stops
+ * as soon as it crosses a bound, so a clear case is decided in a sample or
+ * two.
+ *
+ * alpha and beta hold only for independent samples: reads of a sensor that
+ * does not move repeat the same error, they must be spaced by the caller.
+ */
+
+/**
+ * @brief Decision of the test
+ */
+enum { SPRT_CONTINUE, SPRT_ACCEPT, SPRT_REJECT, SPRT_RESULT_COUNT };
+
+/**
+ * @brief State of a test
+ */
+typedef struct {
+    float hit;   // Added to the log ratio by a hit
+    float miss;  // Added by a miss
+    float upper; // Accept above
+    float lower; // Reject below
+    float llr;   // Log of the likelihood ratio so far
+    int count;   // Samples added
+} SPRT;
+
+/**
+ * @brief Start a test of p_accept against p_reject
+ *
+ * @param t the test
+ * @param p_accept the probability of a hit if the hypothesis is true
+ * @param p_reject the probability of a hit if it is false (< p_accept)
+ * @param alpha the probability to accept wrongly
+ * @param beta the probability to reject wrongly
+ */
+void sprt_init(SPRT *t, float p_accept, float p_reject, float alpha,
+               float beta);
+
+/**
+ * @brief Add a sample to a test
+ *
+ * @param t the test
+ * @param hit if the sample is a hit
+ * @return int SPRT_ACCEPT or SPRT_REJECT once decided, else SPRT_CONTINUE
+ */
+int sprt_add(SPRT *t, bool hit);
+
+#endif /* SPRT_H */
@@ -0,0 +1,87 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../include/crc32.h"
+#include "telemetry.h"
+
+static TELEMETRY_BLOCK *blocks = NULL; // The file, mapped in memory
+static int block_count = 0;
+static size_t map_size = 0;
+static uint32_t block_seq = 0;   // Number of the block being filled
+static uint32_t record_inx = 0;  // Next record of the block being filled
+
+int telemetry_open(const char *path, int count) {
+    if (count <= 0) {
+        return 1;
+    }
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror("telemetry");
+        return 1;
+    }
+    map_size = (size_t)count * sizeof(TELEMETRY_BLOCK);
+    // All the space is taken now, not in the middle of the run
+    if (ftruncate(fd, map_size) || posix_fallocate(fd, 0, map_size)) {
+        perror("telemetry");
+        close(fd);
+        return 1;
+    }
+    void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the file
+    if (map == MAP_FAILED) {
+        perror("telemetry");
+        return 1;
+    }
+    memset(map, 0, map_size); // Touch every page now, not during the run
+    blocks = map;
+    block_count = count;
+    block_seq = 0;
+    record_inx = 0;
+    return 0;
+}
+
+/**
+ * @brief Write the header of the block being filled
+ */
+static void telemetry_seal(void) {
+    TELEMETRY_BLOCK *block = &blocks[block_seq % block_count];
+    TELEMETRY_BLOCK_HEADER *h = &block->header;
+    h->magic = TELEMETRY_MAGIC;
+    h->version = TELEMETRY_VERSION;
+    h->record_size = sizeof(TELEMETRY_RECORD);
+    h->seq = block_seq;
+    h->count = record_inx;
+    h->crc = crc32(0, (const char *)block->record,
+                   record_inx * sizeof(TELEMETRY_RECORD));
+}
+
+void telemetry_log(const TELEMETRY_RECORD *record) {
+    if (!blocks) {
+        return;
+    }
+    TELEMETRY_BLOCK *block = &blocks[block_seq % block_count];
+    if (record_inx == 0) {
+        block->header.magic = 0; // Not valid until sealed, it is reused
+    }
+    block->record[record_inx++] = *record;
+    if (record_inx == TELEMETRY_BLOCK_RECORDS) {
+        telemetry_seal();
+        block_seq++;
+        record_inx = 0;
+    }
+}
+
+void telemetry_close(void) {
+    if (!blocks) {
+        return;
+    }
+    if (record_inx) {
+        telemetry_seal();
+    }
+    msync(blocks, map_size, MS_SYNC);
+    munmap(blocks, map_size);
+    blocks = NULL;
+}
@@ -0,0 +1,111 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Binary log of every tick of the control loop. The records are written in
+ * blocks of a file mapped in memory, so logging a tick is a copy in memory and
+ * no syscall. When a block is full its header is written, with the crc32 of
+ * its records. The file is a ring: once the last block is written, the first
+ * one is reused. tools/telemetry_decode reads it back on the computer.
+ *
+ * The layout is the same on the brick and on the computer (little endian,
+ * fixed size types), change TELEMETRY_VERSION when it changes.
+ */
+
+#define TELEMETRY_MAGIC 0x4d4c4554 // "TELM"
+#define TELEMETRY_VERSION 2
+#define TELEMETRY_BLOCK_RECORDS 64
+#define TELEMETRY_SAMPLES 5 // Sensors of the hub, in the order of HUB_*
+#define TELEMETRY_NO_SAMPLE INT32_MIN // In sample_us, not read yet
+
+/**
+ * @brief State of the clamp, deduced from the last command
+ */
+enum {
+    TELEMETRY_CLAMP_STOPPED = 0,
+    TELEMETRY_CLAMP_OPENING,
+    TELEMETRY_CLAMP_CLOSING,
+    TELEMETRY_CLAMP_HOLDING, // Running forever to keep the flag
+};
+
+/**
+ * @brief State of the robot at the end of a tick
+ * The samples are the last ones of the sensor hub, as the program got them
+ * (the gyro with its bias removed), with their time: tools/replay publishes them
+ * again at the same time relative to the tick.
+ */
+typedef struct {
+    int64_t time_us;        // Monotonic clock, at the end of the tick
+    int64_t tick_us;        // When the tick was due (tick_time_us)
+    uint32_t tick;          // Number of the tick
+    int32_t wake_us;        // When it started, after tick_us
+    int32_t sample_us[TELEMETRY_SAMPLES]; // Time of the samples - tick_us
+    float sonar_raw;        // Last sample of the sonar (mm)
+    float sonar;            // Filtered value used by the program (mm)
+    float gyro;             // Angle (degrees)
+    float gyro_rate;        // Rate (degrees / s)
+    int32_t position_left;  // Position of the wheels (tacho counts)
+    int32_t position_right;
+    int16_t cmd_left;       // Speeds commanded to the wheels
+    int16_t cmd_right;
+    int16_t speed_left;     // Speeds measured by the tachos
+    int16_t speed_right;
+    int16_t cmd_clamp;      // Speed commanded to the clamp
+    uint8_t action;
+    uint8_t color;
+    uint8_t clamp;          // TELEMETRY_CLAMP_*
+    uint8_t state_left;     // State of the tachos at their last read (TACHO_*)
+    uint8_t state_right;
+    uint8_t state_clamp;
+    uint8_t reserved[4];
+} TELEMETRY_RECORD;
+
+/**
+ * @brief Header of a block of records
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t seq;   // Number of the block since the start of the log
+    uint32_t count; // Number of records in the block
+    uint32_t crc;   // crc32 of the records
+    uint32_t reserved;
+} TELEMETRY_BLOCK_HEADER;
+
+/**
+ * @brief A block of the file
+ */
+typedef struct {
+    TELEMETRY_BLOCK_HEADER header;
+    TELEMETRY_RECORD record[TELEMETRY_BLOCK_RECORDS];
+} TELEMETRY_BLOCK;
+
+_Static_assert(sizeof(TELEMETRY_RECORD) == 88, "layout of the records");
+_Static_assert(sizeof(TELEMETRY_BLOCK_HEADER) == 24, "layout of the blocks");
+
+/**
+ * @brief Create the file of the log and map it
+ *
+ * @param path the path of the file
+ * @param blocks the number of blocks of the ring
+ * @return int 0 if the log is ready
+ */
+int telemetry_open(const char *path, int blocks);
+
+/**
+ * @brief Add a record to the log, does nothing if the log is not open
+ *
+ * @param record the record
+ */
+void telemetry_log(const TELEMETRY_RECORD *record);
+
+/**
+ * @brief Write the last block, flush the file and close it
+ */
+void telemetry_close(void);
+
+#endif /* TELEMETRY_H */
@@ -0,0 +1,139 @@
+#define _GNU_SOURCE // SCHED_RESET_ON_FORK
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "clock.h"
+#include "instr.h"
+#include "tick.h"
+
+#define TICK_PRIORITY 50 // Of the control loop, below the kernel ones
+#define TICK_THREADS 4    // Other threads that can be made realtime
+
+typedef struct {
+    pthread_t thread;
+    int priority;
+} TICK_THREAD;
+
+static TICK_THREAD threads[TICK_THREADS];
+static int thread_count = 0;
+static bool realtime_on = false;
+static pthread_mutex_t threads_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static long long period_us = 0;
+static long long next_us = 0;
+static long long due_us = 0;  // When the current tick was due
+static long long wake_us = 0; // When it started
+static TICK_STATS stats;
+static void (*tick_hook)(void) = NULL;
+
+/**
+ * @brief Run a thread under SCHED_FIFO
+ *
+ * @param t the thread and its priority
+ * @return bool true if it was allowed
+ */
+static bool thread_realtime(const TICK_THREAD *t) {
+    struct sched_param param = {.sched_priority = t->priority};
+    int err = pthread_setschedparam(t->thread, SCHED_FIFO, &param);
+    if (err) {
+        fprintf(stderr, "pthread_setschedparam: %s\n", strerror(err));
+    }
+    return !err;
+}
+
+bool tick_init(int period_ms, bool realtime) {
+    period_us = (long long)period_ms * 1000;
+    wake_us = clock_now_us();
+    due_us = wake_us;
+    next_us = wake_us + period_us;
+    memset(&stats, 0, sizeof(stats));
+    if (!realtime) {
+        return false;
+    }
+
+    bool ok = true;
+    // No page fault in the middle of a tick
+    if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+        perror("mlockall");
+        ok = false;
+    }
+    struct sched_param param = {.sched_priority = TICK_PRIORITY};
+    // The processes we fork (aplay, espeak) do not inherit SCHED_FIFO
+    if (sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &param)) {
+        perror("sched_setscheduler");
+        ok = false;
+    }
+    // The threads started before do not inherit it
+    pthread_mutex_lock(&threads_lock);
+    realtime_on = true;
+    for (int i = 0; i < thread_count; i++) {
+        ok = thread_realtime(&threads[i]) && ok;
+    }
+    pthread_mutex_unlock(&threads_lock);
+    if (!ok) {
+        printf("Could not run in realtime, continuing without it\n");
+    }
+    return ok;
+}
+
+void tick_add_thread(pthread_t thread, int priority) {
+    pthread_mutex_lock(&threads_lock);
+    if (thread_count < TICK_THREADS) {
+        TICK_THREAD *t = &threads[thread_count++];
+        t->thread = thread;
+        t->priority = priority;
+        if (realtime_on) {
+            thread_realtime(t);
+        }
+    }
+    pthread_mutex_unlock(&threads_lock);
+}
+
+void tick_remove_thread(pthread_t thread) {
+    pthread_mutex_lock(&threads_lock);
+    for (int i = 0; i < thread_count; i++) {
+        if (pthread_equal(threads[i].thread, thread)) {
+            threads[i] = threads[--thread_count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&threads_lock);
+}
+
+void tick_set_hook(void (*hook)(void)) { tick_hook = hook; }
+
+void tick_wait(void) {
+    if (tick_hook) {
+        tick_hook();
+    }
+    long long now = clock_now_us();
+    instr_tick(now - wake_us);
+    stats.ticks++;
+    if (now >= next_us) { // The work took more than the period
+        stats.misses++;
+        next_us = now + period_us; // Start again from now, do not burst
+        due_us = now;
+        wake_us = now;
+        return;
+    }
+    clock_sleep_until_us(next_us);
+    due_us = next_us;
+    wake_us = clock_now_us();
+    long long late = wake_us - next_us;
+    stats.jitter_sum_us += late;
+    if (late > stats.jitter_max_us) {
+        stats.jitter_max_us = late;
+    }
+    next_us += period_us;
+}
+
+long long tick_time_us(void) {
+    return period_us ? due_us : clock_now_us();
+}
+
+long long tick_wake_us(void) { return period_us ? wake_us : clock_now_us(); }
+
+void tick_get_stats(TICK_STATS *out) { *out = stats; }
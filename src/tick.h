@@ -0,0 +1,90 @@
+#ifndef TICK_H
+#define TICK_H
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/*
+ * Fixed rate scheduler of the control loop. Every loop of the program waits
+ * for the next tick with tick_wait(), the ticks are absolute deadlines on the
+ * monotonic clock so the rate does not drift with the time spent working.
+ *
+ * The control takes its time from tick_time_us rather than from the clock:
+ * it is the same during the whole tick, whatever the thread was late to wake
+ * up, so tools/replay gives it back exactly from the log.
+ */
+
+/**
+ * @brief Statistics of the ticks
+ */
+typedef struct {
+    unsigned long ticks;     // Number of ticks waited for
+    unsigned long misses;    // Ticks whose deadline had passed before the wait
+    long long jitter_max_us; // Worst delay between a deadline and the wake up
+    long long jitter_sum_us; // Sum of the delays, to compute the mean
+} TICK_STATS;
+
+/**
+ * @brief Start the scheduler
+ * In realtime, the memory is locked and the thread runs under SCHED_FIFO, as
+ * the threads given to tick_add_thread. If this is not allowed, a warning is
+ * printed and the scheduler runs normally.
+ *
+ * @param period_ms the time between two ticks
+ * @param realtime true to use SCHED_FIFO and mlockall
+ * @return bool true if realtime was asked and obtained
+ */
+bool tick_init(int period_ms, bool realtime);
+
+/**
+ * @brief Make a thread run under SCHED_FIFO along the control loop
+ * A thread does not inherit it from the one that created it, whether it was
+ * created before tick_init or after.
+ *
+ * @param thread the thread
+ * @param priority its priority, the control loop has 50
+ */
+void tick_add_thread(pthread_t thread, int priority);
+
+/**
+ * @brief Forget a thread, to call before it is joined
+ *
+ * @param thread the thread
+ */
+void tick_remove_thread(pthread_t thread);
+
+/**
+ * @brief Set a function called at the end of every tick, before waiting
+ *
+ * @param hook the function (NULL for none)
+ */
+void tick_set_hook(void (*hook)(void));
+
+/**
+ * @brief Wait for the next tick
+ */
+void tick_wait(void);
+
+/**
+ * @brief Get the time the current tick was due at
+ * Before tick_init, it is the time of the clock.
+ *
+ * @return long long the time in microseconds
+ */
+long long tick_time_us(void);
+
+/**
+ * @brief Get the time the current tick really started, after tick_time_us
+ *
+ * @return long long the time in microseconds
+ */
+long long tick_wake_us(void);
+
+/**
+ * @brief Get the statistics of the ticks
+ *
+ * @param stats where to store the statistics
+ */
+void tick_get_stats(TICK_STATS *stats);
+
+#endif /* TICK_H */
@@ -0,0 +1,28 @@
+#include <math.h>
+
+#include "turn_profile.h"
+
+float turn_profile_rate(const TURN_PROFILE *p, float remaining,
+                        float previous, float dt) {
+    float rate = sqrtf(2 * p->accel * fabsf(remaining)); // Stop on the target
+    if (rate > p->max_rate) {
+        rate = p->max_rate;
+    }
+    float up = fabsf(previous) + p->accel * dt; // Ramp up
+    if (rate > up) {
+        rate = up;
+    }
+    if (rate < p->min_rate) {
+        rate = p->min_rate;
+    }
+    return (remaining < 0) ? -rate : rate;
+}
+
+float turn_profile_time(const TURN_PROFILE *p, float angle) {
+    angle = fabsf(angle);
+    float ramp = p->max_rate * p->max_rate / p->accel; // Up and down
+    if (angle < ramp) { // Triangle, max_rate is never reached
+        return 2 * sqrtf(angle / p->accel);
+    }
+    return 2 * p->max_rate / p->accel + (angle - ramp) / p->max_rate;
+}
@@ -0,0 +1,41 @@
+#ifndef TURN_PROFILE_H
+#define TURN_PROFILE_H
+
+/*
+ * Trapezoidal profile of the rate of a turn in place: the rate ramps up to
+ * max_rate, then goes down so it reaches 0 at the target. It is computed
+ * again from the remaining angle at each step, so the profile follows what
+ * the gyro measures.
+ */
+
+/**
+ * @brief Limits of the profile
+ */
+typedef struct {
+    float max_rate; // degrees / s
+    float accel;    // Of the rate, up and down (degrees / s^2)
+    float min_rate; // Slower, the wheels stall (degrees / s)
+} TURN_PROFILE;
+
+/**
+ * @brief Get the rate to turn at
+ *
+ * @param p the profile
+ * @param remaining the angle left to turn (degrees, > 0 clockwise)
+ * @param previous the rate returned by the last step, 0 at the start
+ * @param dt the time since the last step (s)
+ * @return float the rate (degrees / s), the sign of remaining
+ */
+float turn_profile_rate(const TURN_PROFILE *p, float remaining,
+                        float previous, float dt);
+
+/**
+ * @brief Get the time a turn should take
+ *
+ * @param p the profile
+ * @param angle the angle to turn (degrees)
+ * @return float the time (s)
+ */
+float turn_profile_time(const TURN_PROFILE *p, float angle);
+
+#endif /* TURN_PROFILE_H */
@@ -0,0 +1,182 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+void arena_default(ARENA *arena) {
+    memset(arena, 0, sizeof(*arena));
+    arena->width = 1200;
+    arena->height = 2400;
+    arena_add_border(arena);
+    arena->flag_x = 290;
+    arena->flag_y = 2150;
+    arena->base = (ZONE){0, 0, 600, 600};
+    arena->opponent = (OPPONENT){.present = true,
+                                 .radius = 120,
+                                 .x0 = 200,
+                                 .y0 = 1200,
+                                 .x1 = 1000,
+                                 .y1 = 1200,
+                                 .speed = 150};
+    arena->start = (POSE){300, 300, 0};
+    arena->floor_color = 6; // WHITE
+    arena_step(arena, 0);
+}
+
+/**
+ * @brief Get a random number between low and high
+ */
+static double uniform(unsigned *seed, double low, double high) {
+    return low + (high - low) * rand_r(seed) / ((double)RAND_MAX + 1);
+}
+
+void arena_randomize(ARENA *arena, unsigned *seed) {
+    OPPONENT *o = &arena->opponent;
+    o->y0 = o->y1 = uniform(seed, 900, 1500);
+    o->speed = uniform(seed, 100, 250);
+    o->phase = uniform(seed, 0, 1);
+    arena->start.x += uniform(seed, -20, 20);
+    arena->start.y += uniform(seed, -20, 20);
+    arena->start.heading += uniform(seed, -5, 5);
+    arena_step(arena, 0);
+}
+
+void arena_add_border(ARENA *arena) {
+    double w = arena->width;
+    double h = arena->height;
+    const SEGMENT border[] = {
+        {0, 0, w, 0}, {w, 0, w, h}, {w, h, 0, h}, {0, h, 0, 0}};
+    for (int i = 0; (i < 4) && (arena->walls < ARENA_MAX_WALLS); i++) {
+        arena->wall[arena->walls++] = border[i];
+    }
+}
+
+void arena_step(ARENA *arena, long long t_us) {
+    OPPONENT *o = &arena->opponent;
+    double dx = o->x1 - o->x0;
+    double dy = o->y1 - o->y0;
+    double len = sqrt(dx * dx + dy * dy);
+    double s = 0;
+    if (len > 0) { // Back and forth, s from 0 to len
+        s = fmod(o->phase * 2 * len + o->speed * t_us / 1e6, 2 * len);
+        if (s > len) {
+            s = 2 * len - s;
+        }
+        s /= len;
+    }
+    o->x = o->x0 + dx * s;
+    o->y = o->y0 + dy * s;
+}
+
+/**
+ * @brief Intersection of a ray and a wall
+ *
+ * @param w the wall
+ * @param x the start of the ray
+ * @param y the start of the ray
+ * @param dx the direction of the ray (unit vector)
+ * @param dy the direction of the ray
+ * @param cos_incidence where to store the cosine of the incidence
+ * @return double the distance, -1 if the ray does not hit the wall
+ */
+static double ray_segment(const SEGMENT *w, double x, double y, double dx,
+                          double dy, double *cos_incidence) {
+    double ex = w->x1 - w->x0;
+    double ey = w->y1 - w->y0;
+    double det = ex * dy - ey * dx;
+    if (fabs(det) < 1e-12) {
+        return -1; // Parallel
+    }
+    double qx = w->x0 - x;
+    double qy = w->y0 - y;
+    double t = (ex * qy - ey * qx) / det; // Along the ray
+    double u = (dx * qy - dy * qx) / det; // Along the wall
+    if ((t < 0) || (u < 0) || (u > 1)) {
+        return -1;
+    }
+    *cos_incidence = fabs(det) / sqrt(ex * ex + ey * ey);
+    return t;
+}
+
+/**
+ * @brief Intersection of a ray and the opponent
+ */
+static double ray_disc(const OPPONENT *o, double x, double y, double dx,
+                       double dy, double *cos_incidence) {
+    double qx = o->x - x;
+    double qy = o->y - y;
+    double along = qx * dx + qy * dy;
+    double d2 = qx * qx + qy * qy - along * along; // Distance to the ray ^2
+    double r2 = o->radius * o->radius;
+    if ((along < 0) || (d2 > r2)) {
+        return -1;
+    }
+    *cos_incidence = sqrt(1 - d2 / r2);
+    return along - sqrt(r2 - d2);
+}
+
+double arena_ray(const ARENA *arena, double x, double y, double heading,
+                 double *incidence) {
+    double a = heading * M_PI / 180;
+    double dx = sin(a);
+    double dy = cos(a);
+    double best = -1;
+    double best_cos = 1;
+    double c;
+    for (int i = 0; i < arena->walls; i++) {
+        double t = ray_segment(&arena->wall[i], x, y, dx, dy, &c);
+        if ((t >= 0) && ((best < 0) || (t < best))) {
+            best = t;
+            best_cos = c;
+        }
+    }
+    if (arena->opponent.present) {
+        double t = ray_disc(&arena->opponent, x, y, dx, dy, &c);
+        if ((t >= 0) && ((best < 0) || (t < best))) {
+            best = t;
+            best_cos = c;
+        }
+    }
+    if (incidence) {
+        *incidence = acos(fmin(1, best_cos)) * 180 / M_PI;
+    }
+    return best;
+}
+
+bool arena_collides(const ARENA *arena, double x, double y, double radius) {
+    for (int i = 0; i < arena->walls; i++) {
+        const SEGMENT *w = &arena->wall[i];
+        double ex = w->x1 - w->x0;
+        double ey = w->y1 - w->y0;
+        double len2 = ex * ex + ey * ey;
+        double u = (len2 > 0)
+                       ? ((x - w->x0) * ex + (y - w->y0) * ey) / len2
+                       : 0;
+        u = fmax(0, fmin(1, u));
+        double px = w->x0 + u * ex - x;
+        double py = w->y0 + u * ey - y;
+        if (px * px + py * py < radius * radius) {
+            return true;
+        }
+    }
+    const OPPONENT *o = &arena->opponent;
+    if (o->present) {
+        double r = radius + o->radius;
+        double px = o->x - x;
+        double py = o->y - y;
+        if (px * px + py * py < r * r) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool arena_in_zone(const ZONE *zone, double x, double y) {
+    return (x >= zone->x0) && (x <= zone->x1) && (y >= zone->y0) &&
+           (y <= zone->y1);
+}
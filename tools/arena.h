@@ -0,0 +1,138 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+
+/*
+ * Geometry of the arena the simulated robot moves in: the walls, the flag,
+ * our base and an opponent that goes back and forth between two points.
+ *
+ * Coordinates are in mm, x to the right and y away from our side. The heading
+ * is in degrees, clockwise like the gyro, 0 is toward +y.
+ *
+ * The flag is low: the clamp can take it, the sonar does not see it. The
+ * opponent is a disc the sonar sees and the robot can not go through.
+ */
+
+#define ARENA_MAX_WALLS 16
+
+/**
+ * @brief Position of the robot
+ */
+typedef struct {
+    double x;       // mm
+    double y;       // mm
+    double heading; // degrees, clockwise
+} POSE;
+
+/**
+ * @brief A wall, from (x0, y0) to (x1, y1)
+ */
+typedef struct {
+    double x0;
+    double y0;
+    double x1;
+    double y1;
+} SEGMENT;
+
+/**
+ * @brief A rectangle on the floor, from (x0, y0) to (x1, y1)
+ */
+typedef struct {
+    double x0;
+    double y0;
+    double x1;
+    double y1;
+} ZONE;
+
+/**
+ * @brief The other robot
+ */
+typedef struct {
+    bool present;
+    double radius;    // mm
+    double x0, y0;    // One end of its path
+    double x1, y1;    // The other end
+    double speed;     // mm / s, 0 if it does not move
+    double phase;     // Where it starts on its path (0 to 1)
+    double x, y;      // Where it is (see arena_step)
+} OPPONENT;
+
+/**
+ * @brief The arena, and where things are in it
+ */
+typedef struct {
+    double width;  // mm
+    double height; // mm
+    SEGMENT wall[ARENA_MAX_WALLS];
+    int walls;
+    double flag_x, flag_y; // Where the flag is when no one holds it
+    ZONE base;             // Where the flag must be brought
+    OPPONENT opponent;
+    POSE start;            // Where our robot starts
+    int floor_color;       // What the color sensor sees without the flag
+} ARENA;
+
+/**
+ * @brief Make the arena of the match: 1200 x 2400 mm, the flag on the other
+ * side, our base in the corner we start from, the opponent in the middle
+ *
+ * @param arena where to store it
+ */
+void arena_default(ARENA *arena);
+
+/**
+ * @brief Change the arena of a match at random: where the opponent goes and
+ * how fast, where and how our robot starts
+ *
+ * @param arena the arena, from arena_default
+ * @param seed the state of the random numbers (rand_r)
+ */
+void arena_randomize(ARENA *arena, unsigned *seed);
+
+/**
+ * @brief Add the four walls of a rectangle arena
+ *
+ * @param arena the arena, with its width and height set
+ */
+void arena_add_border(ARENA *arena);
+
+/**
+ * @brief Move the opponent to where it is at a time
+ *
+ * @param arena the arena
+ * @param t_us the time since the start of the match
+ */
+void arena_step(ARENA *arena, long long t_us);
+
+/**
+ * @brief Cast a ray from a point, against the walls and the opponent
+ *
+ * @param arena the arena
+ * @param x the start of the ray
+ * @param y the start of the ray
+ * @param heading the direction of the ray (degrees, clockwise)
+ * @param incidence where to store the angle between the ray and the normal of
+ * what it hit (degrees, can be NULL)
+ * @return double the distance to what it hit (mm), -1 if nothing
+ */
+double arena_ray(const ARENA *arena, double x, double y, double heading,
+                 double *incidence);
+
+/**
+ * @brief Tell if a disc is in a wall or in the opponent
+ *
+ * @param arena the arena
+ * @param x the center of the disc
+ * @param y the center of the disc
+ * @param radius the radius of the disc
+ * @return bool true if it touches something
+ */
+bool arena_collides(const ARENA *arena, double x, double y, double radius);
+
+/**
+ * @brief Tell if a point is in a zone
+ */
+bool arena_in_zone(const ZONE *zone, double x, double y);
+
+#endif /* ARENA_H */
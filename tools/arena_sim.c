@@ -0,0 +1,184 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/telemetry.h"
+#include "arena.h"
+#include "diff_drive.h"
+#include "host.h"
+
+/*
+ * Play a match of the program of the robot on the computer, in simulated
+ * time, in the arena of tools/arena.c. A match of 3 minutes takes a fraction
+ * of a second, so the thresholds of main() can be compared by the time the
+ * robot takes to catch the flag and bring it to the base.
+ *
+ * Usage: arena_sim [-v] [-q] [-n] [-r seed] [-t seconds] > program.txt
+ *   -v print the position of the robot every half second
+ *   -q print only the result, on one line (for tools/monte_carlo):
+ *      in_base caught_us base_us end_us (-1 if it did not happen)
+ *   -n no opponent
+ *   -r a random match (opponent, start, noise of the sensors) of this seed
+ *   -t the length of the match (default 180 s)
+ * Return 0 if the flag is in the base at the end, 1 if not, 2 if error.
+ */
+
+#define MATCH_END 100    // Status of host_run when the time is over
+#define MATCH_SECONDS 180
+#define PRINT_US 500000  // Period of the position printed with -v
+
+// Noise of the sensors of a random match
+#define NOISE_SONAR_SD 5       // mm
+#define NOISE_SONAR_SPIKE 0.01 // Reads that see nothing
+#define NOISE_GYRO_DRIFT 0.05  // Largest drift (degrees / s)
+#define NOISE_GYRO_SD 0.5      // Of the rate (degrees / s)
+
+int robot_main(void); // main.c
+
+static ARENA arena;
+static long long match_start;
+static long long match_end;
+static long long print_next;
+static bool verbose = false;
+
+static struct {
+    long long caught_us; // When the clamp took the flag, -1 if never
+    long long base_us;   // When the flag was first in the base, -1 if never
+} result = {-1, -1};
+
+/**
+ * @brief Advance the arena and the robot, and see what happened to the flag
+ *
+ * @param now_us the time of the simulated clock
+ */
+static void match_step(long long now_us) {
+    diff_drive_step(now_us);
+    bool held = diff_drive_flag_held();
+    if (held && (result.caught_us < 0)) {
+        result.caught_us = now_us - match_start;
+    }
+    if ((result.caught_us >= 0) && (result.base_us < 0) &&
+        arena_in_zone(&arena.base, arena.flag_x, arena.flag_y)) {
+        result.base_us = now_us - match_start;
+    }
+    if (verbose && (now_us >= print_next)) {
+        POSE pose;
+        diff_drive_get_pose(&pose);
+        fprintf(stderr, "%7.2f s: x %5.0f y %5.0f heading %6.1f%s\n",
+                (now_us - match_start) / 1e6, pose.x, pose.y, pose.heading,
+                held ? " flag" : "");
+        print_next = now_us + PRINT_US;
+    }
+    if (now_us >= match_end) {
+        host_exit(MATCH_END);
+    }
+}
+
+static const HOST_MODEL match_model = {match_step, diff_drive_command};
+
+// No log of the match, telemetry.c is replaced by this
+
+int telemetry_open(const char *path, int blocks) {
+    (void)path;
+    (void)blocks;
+    return 0;
+}
+
+void telemetry_log(const TELEMETRY_RECORD *record) { (void)record; }
+
+void telemetry_close(void) {}
+
+int main(int argc, char **argv) {
+    int seconds = MATCH_SECONDS;
+    bool quiet = false;
+    bool opponent = true;
+    bool random = false;
+    unsigned seed = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "vqnr:t:")) != -1) {
+        switch (opt) {
+        case 'v':
+            verbose = true;
+            break;
+        case 'q':
+            quiet = true;
+            break;
+        case 'n':
+            opponent = false;
+            break;
+        case 'r':
+            random = true;
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr,
+                    "Usage: %s [-v] [-q] [-n] [-r seed] [-t seconds]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    arena_default(&arena);
+    DIFF_DRIVE_NOISE noise = {0};
+    if (random) {
+        arena_randomize(&arena, &seed);
+        noise.seed = rand_r(&seed);
+        noise.sonar_sd = NOISE_SONAR_SD;
+        noise.sonar_spike = NOISE_SONAR_SPIKE;
+        noise.gyro_drift =
+            NOISE_GYRO_DRIFT * (2.0 * rand_r(&seed) / RAND_MAX - 1);
+        noise.gyro_sd = NOISE_GYRO_SD;
+    }
+    arena.opponent.present = opponent;
+    match_start = print_next = 0;
+    match_end = match_start + (long long)seconds * 1000000;
+    host_init(&match_model, match_start);
+    diff_drive_init(&arena, match_start);
+    diff_drive_set_noise(&noise);
+
+    int out = -1;
+    if (quiet) { // The program prints on stdout, keep it for the result
+        fflush(stdout);
+        out = dup(STDOUT_FILENO);
+        if ((out < 0) || !freopen("/dev/null", "w", stdout)) {
+            perror("arena_sim");
+            return 2;
+        }
+    }
+
+    clock_t cpu = clock();
+    int status = host_run(robot_main);
+    cpu = clock() - cpu;
+
+    bool in_base = arena_in_zone(&arena.base, arena.flag_x, arena.flag_y);
+    if (quiet) {
+        dprintf(out, "%d %lld %lld %lld\n", in_base, result.caught_us,
+                result.base_us, host_now_us() - match_start);
+        return in_base ? 0 : 1;
+    }
+
+    POSE pose;
+    diff_drive_get_pose(&pose);
+    fprintf(stderr, "%s after %.1f s (%.2f s of CPU)\n",
+            (status == MATCH_END) ? "End of the match" : "Program returned",
+            (host_now_us() - match_start) / 1e6,
+            (double)cpu / CLOCKS_PER_SEC);
+    fprintf(stderr, "Robot at x %.0f y %.0f heading %.1f\n", pose.x, pose.y,
+            pose.heading);
+    if (result.caught_us >= 0) {
+        fprintf(stderr, "Flag caught at %.2f s\n", result.caught_us / 1e6);
+    } else {
+        fprintf(stderr, "Flag not caught\n");
+    }
+    if (result.base_us >= 0) {
+        fprintf(stderr, "Flag in the base at %.2f s%s\n",
+                result.base_us / 1e6, in_base ? "" : ", then out of it");
+    }
+    return in_base ? 0 : 1;
+}
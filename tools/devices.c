@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/ev3_tacho.h"
+#include "../src/ev3_attr.h"
+#include "../src/motor.h"
+#include "devices.h"
+
+DEVICE_SENSOR device_sensor[DEVICE_SENSOR_COUNT];
+DEVICE_TACHO device_tacho[DEVICE_TACHO_COUNT];
+
+static const char *state_name[] = {"running", "ramping", "holding",
+                                   "overloaded", "stalled"};
+
+void devices_reset(void) {
+    static const char *sensor_driver[DEVICE_SENSOR_COUNT] = {
+        [DEVICE_SONAR] = "lego-ev3-us",
+        [DEVICE_GYRO] = "lego-ev3-gyro",
+        [DEVICE_COLOR] = "lego-ev3-color",
+    };
+    static const char *sensor_mode[DEVICE_SENSOR_COUNT] = {
+        [DEVICE_SONAR] = "US-DIST-CM",
+        [DEVICE_GYRO] = "GYRO-ANG",
+        [DEVICE_COLOR] = "COL-COLOR",
+    };
+    static const char *sensor_address[DEVICE_SENSOR_COUNT] = {
+        "ev3-ports:in1", "ev3-ports:in2", "ev3-ports:in3"};
+    static const char *tacho_address[DEVICE_TACHO_COUNT] = {
+        "ev3-ports:outA", "ev3-ports:outB", "ev3-ports:outC"};
+
+    memset(device_sensor, 0, sizeof(device_sensor));
+    memset(device_tacho, 0, sizeof(device_tacho));
+    for (int sn = 0; sn < DEVICE_SENSOR_COUNT; sn++) {
+        DEVICE_SENSOR *s = &device_sensor[sn];
+        s->driver_name = sensor_driver[sn];
+        s->address = sensor_address[sn];
+        snprintf(s->mode, sizeof(s->mode), "%s", sensor_mode[sn]);
+        s->values.count = 1;
+    }
+    for (int sn = 0; sn < DEVICE_TACHO_COUNT; sn++) {
+        DEVICE_TACHO *t = &device_tacho[sn];
+        t->driver_name = "lego-ev3-l-motor";
+        t->address = tacho_address[sn];
+        t->max_speed = 1050;
+        t->count_per_rot = 360;
+        t->stop_action = TACHO_COAST;
+    }
+}
+
+int devices_count(int cls) {
+    return (cls == EV3_ATTR_SENSOR) ? DEVICE_SENSOR_COUNT : DEVICE_TACHO_COUNT;
+}
+
+/**
+ * @brief Get the content of an attribute of a sensor
+ */
+static bool sensor_format(DEVICE_SENSOR *s, int attr, char *buf, size_t sz) {
+    switch (attr) {
+    case EV3_ATTR_ADDRESS:
+        snprintf(buf, sz, "%s", s->address);
+        return true;
+    case EV3_ATTR_DRIVER_NAME:
+        snprintf(buf, sz, "%s", s->driver_name);
+        return true;
+    case EV3_ATTR_MODE:
+        snprintf(buf, sz, "%s", s->mode);
+        return true;
+    case EV3_ATTR_NUM_VALUES:
+        snprintf(buf, sz, "%d", s->values.count);
+        return true;
+    case EV3_ATTR_DECIMALS:
+        snprintf(buf, sz, "0");
+        return true;
+    case EV3_ATTR_BIN_DATA_FORMAT:
+        snprintf(buf, sz, "float");
+        return true;
+    }
+    if ((attr >= EV3_ATTR_VALUE0) && (attr <= EV3_ATTR_VALUE7)) {
+        int i = attr - EV3_ATTR_VALUE0;
+        if (i >= s->values.count) {
+            return false;
+        }
+        snprintf(buf, sz, "%d", (int)s->values.value[i]);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Get the content of an attribute of a tacho
+ */
+static bool tacho_format(DEVICE_TACHO *t, int attr, char *buf, size_t sz) {
+    int value;
+    switch (attr) {
+    case EV3_ATTR_ADDRESS:
+        snprintf(buf, sz, "%s", t->address);
+        return true;
+    case EV3_ATTR_DRIVER_NAME:
+        snprintf(buf, sz, "%s", t->driver_name);
+        return true;
+    case EV3_ATTR_COMMAND: // Write only
+        buf[0] = '\0';
+        return true;
+    case EV3_ATTR_STOP_ACTION:
+        snprintf(buf, sz, "%s", motor_stop_action_name(t->stop_action));
+        return true;
+    case EV3_ATTR_STATE:
+        buf[0] = '\0';
+        for (int i = 0; i < 5; i++) {
+            if (t->state & (1 << i)) {
+                size_t len = strlen(buf);
+                snprintf(buf + len, sz - len, "%s%s", len ? " " : "",
+                         state_name[i]);
+            }
+        }
+        return true;
+    case EV3_ATTR_COUNT_PER_ROT:
+        value = t->count_per_rot;
+        break;
+    case EV3_ATTR_MAX_SPEED:
+        value = t->max_speed;
+        break;
+    case EV3_ATTR_POSITION:
+        value = t->position;
+        break;
+    case EV3_ATTR_POSITION_SP:
+        value = t->position_sp;
+        break;
+    case EV3_ATTR_RAMP_DOWN_SP:
+        value = t->ramp_down_sp;
+        break;
+    case EV3_ATTR_RAMP_UP_SP:
+        value = t->ramp_up_sp;
+        break;
+    case EV3_ATTR_SPEED:
+        value = t->speed;
+        break;
+    case EV3_ATTR_SPEED_SP:
+        value = t->speed_sp;
+        break;
+    case EV3_ATTR_TIME_SP:
+        value = t->time_sp;
+        break;
+    default:
+        return false;
+    }
+    snprintf(buf, sz, "%d", value);
+    return true;
+}
+
+bool device_attr_format(int cls, uint8_t sn, int attr, char *buf, size_t sz) {
+    if (sz == 0) {
+        return false;
+    }
+    if ((cls == EV3_ATTR_SENSOR) && (sn < DEVICE_SENSOR_COUNT)) {
+        return sensor_format(&device_sensor[sn], attr, buf, sz);
+    }
+    if ((cls == EV3_ATTR_TACHO) && (sn < DEVICE_TACHO_COUNT)) {
+        return tacho_format(&device_tacho[sn], attr, buf, sz);
+    }
+    return false;
+}
+
+/**
+ * @brief Find the index of a name in a table of motor.c
+ *
+ * @param name the name written
+ * @param name_of the function giving the name of an index
+ * @param count the number of indexes
+ * @param inx where to store the index
+ * @return bool false if the name is unknown
+ */
+static bool parse_inx(const char *name, const char *(*name_of)(INX_T),
+                      int count, INX_T *inx) {
+    for (int i = 0; i < count; i++) {
+        const char *s = name_of(i);
+        if (s && (strcmp(s, name) == 0)) {
+            *inx = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool device_attr_parse(int cls, uint8_t sn, int attr, const char *value) {
+    if (cls == EV3_ATTR_SENSOR) {
+        if ((sn >= DEVICE_SENSOR_COUNT) || (attr != EV3_ATTR_MODE)) {
+            return false;
+        }
+        snprintf(device_sensor[sn].mode, sizeof(device_sensor[sn].mode),
+                 "%s", value);
+        // num_values follows the mode at once, as in the kernel
+        device_sensor[sn].values.count =
+            (strcmp(value, "GYRO-G&A") == 0) ? 2 : 1;
+        return true;
+    }
+    if ((cls != EV3_ATTR_TACHO) || (sn >= DEVICE_TACHO_COUNT)) {
+        return false;
+    }
+    DEVICE_TACHO *t = &device_tacho[sn];
+    int *field = NULL;
+    switch (attr) {
+    case EV3_ATTR_COMMAND:
+        if (!parse_inx(value, motor_command_name, TACHO_COMMAND__COUNT_,
+                       &t->command)) {
+            return false;
+        }
+        t->commands++;
+        return true;
+    case EV3_ATTR_STOP_ACTION:
+        return parse_inx(value, motor_stop_action_name,
+                         TACHO_STOP_ACTION__COUNT_, &t->stop_action);
+    case EV3_ATTR_POSITION:
+        field = &t->position;
+        break;
+    case EV3_ATTR_POSITION_SP:
+        field = &t->position_sp;
+        break;
+    case EV3_ATTR_RAMP_DOWN_SP:
+        field = &t->ramp_down_sp;
+        break;
+    case EV3_ATTR_RAMP_UP_SP:
+        field = &t->ramp_up_sp;
+        break;
+    case EV3_ATTR_SPEED_SP:
+        field = &t->speed_sp;
+        break;
+    case EV3_ATTR_TIME_SP:
+        field = &t->time_sp;
+        break;
+    default:
+        return false;
+    }
+    char *end;
+    long v = strtol(value, &end, 10);
+    if (end == value) {
+        return false;
+    }
+    *field = (int)v;
+    return true;
+}
@@ -0,0 +1,110 @@
+#ifndef DEVICES_H
+#define DEVICES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../include/ev3.h"
+#include "../src/sensor_bin.h"
+
+/*
+ * The devices of the simulated robot, and the text of their sysfs attributes.
+ * The sequence numbers (sn) are the index in the arrays. tools/host.c gives
+ * them to the program directly, tools/ev3_simd writes them in a sysfs tree.
+ * A model (replay of a log, tools/diff_drive.c) makes them move.
+ */
+
+enum {
+    DEVICE_SONAR = 0,
+    DEVICE_GYRO,
+    DEVICE_COLOR,
+
+    DEVICE_SENSOR_COUNT,
+};
+
+enum {
+    DEVICE_WHEEL_LEFT = 0, // Port A
+    DEVICE_WHEEL_RIGHT,    // Port B
+    DEVICE_CLAMP,          // Port C
+
+    DEVICE_TACHO_COUNT,
+};
+
+/**
+ * @brief A sensor, the model sets the values
+ */
+typedef struct {
+    const char *driver_name;
+    const char *address;
+    char mode[32];        // Last mode written by the program
+    SENSOR_VALUES values; // What bin_data and valueN return
+} DEVICE_SENSOR;
+
+/**
+ * @brief A tacho, the program writes the setpoints and the model the rest
+ */
+typedef struct {
+    const char *driver_name;
+    const char *address;
+    int max_speed;
+    int count_per_rot;
+
+    // Written by the program
+    int speed_sp;
+    int time_sp;
+    int position_sp;
+    int ramp_up_sp;
+    int ramp_down_sp;
+    INX_T stop_action;
+    INX_T command;     // Last command
+    uint32_t commands; // Number of commands written
+
+    // Written by the model (and position by the program)
+    int position;
+    int speed;
+    FLAGS_T state;
+} DEVICE_TACHO;
+
+extern DEVICE_SENSOR device_sensor[DEVICE_SENSOR_COUNT];
+extern DEVICE_TACHO device_tacho[DEVICE_TACHO_COUNT];
+
+/**
+ * @brief Put the devices in the state of a robot that was just started
+ */
+void devices_reset(void);
+
+/**
+ * @brief Get the number of devices of a class
+ *
+ * @param cls EV3_ATTR_SENSOR or EV3_ATTR_TACHO
+ * @return int the number of devices
+ */
+int devices_count(int cls);
+
+/**
+ * @brief Get the content of an attribute, as sysfs gives it (no newline)
+ * bin_data is not handled, it is the values of the sensor as float.
+ *
+ * @param cls the class of the device
+ * @param sn the sequence number of the device
+ * @param attr the attribute
+ * @param buf the buffer
+ * @param sz the size of the buffer
+ * @return bool false if the device does not have this attribute
+ */
+bool device_attr_format(int cls, uint8_t sn, int attr, char *buf, size_t sz);
+
+/**
+ * @brief Write an attribute, as the program would
+ * A command is only stored: the caller tells the model.
+ *
+ * @param cls the class of the device
+ * @param sn the sequence number of the device
+ * @param attr the attribute
+ * @param value the text written
+ * @return bool false if the value or the attribute is refused
+ */
+bool device_attr_parse(int cls, uint8_t sn, int attr, const char *value);
+
+#endif /* DEVICES_H */
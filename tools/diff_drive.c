@@ -0,0 +1,353 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/ev3_tacho.h"
+#include "devices.h"
+#include "diff_drive.h"
+
+#define WHEEL_RADIUS 28.0  // mm
+#define AXLE 120.0         // Distance between the wheels (mm)
+#define ROBOT_RADIUS 100.0 // The robot can not go closer to a wall (mm)
+#define SONAR_OFFSET 80.0  // Distance from the center to the sonar (mm)
+#define SONAR_MAX 2550.0   // What the sonar returns when it sees nothing
+#define SONAR_CONE 30.0    // Width of the beam (degrees)
+#define SONAR_RAYS 7       // Rays cast in the beam
+#define SONAR_INCIDENCE 40.0 // Beyond it, the echo does not come back (degrees)
+
+#define CLAMP_TRAVEL 200  // From closed (0) to fully open (counts)
+#define FLAG_REACH_MIN 60 // The clamp takes the flag in front of the center,
+#define FLAG_REACH_MAX 200 // between these distances (mm)
+#define FLAG_REACH_SIDE 70 // and at most this far on the side (mm)
+#define FLAG_HELD 120      // Where the held flag is in front of the center (mm)
+
+#define MOTOR_TAU 0.03   // Time constant of the speed regulation (s)
+#define BRAKE_TAU 0.02   // Time to stop with "brake" (s)
+#define COAST_TAU 0.15   // Time to stop with "coast" (s)
+#define MOTOR_ACCEL 8000 // Deceleration to reach a position (counts / s^2)
+#define HOLD_GAIN 20.0   // Speed per count of error when holding (1 / s)
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/**
+ * @brief State of a motor that is not in its device
+ */
+typedef struct {
+    double position;  // counts
+    double speed;     // counts / s
+    int published;    // Last position written in the device
+    bool running;
+    bool to_position; // run-to-abs-pos or run-to-rel-pos
+    double target;    // Position to reach
+    long long end_us; // End of run-timed, 0 if none
+    bool holding;
+    double hold;      // Position held
+    double low;       // Mechanical stops, none if low == high
+    double high;
+} MOTOR;
+
+static MOTOR motor[DEVICE_TACHO_COUNT];
+static POSE pose;
+static double rate; // Rotation speed (degrees / s, clockwise)
+static ARENA *arena;
+static long long model_start;
+static long long model_now;
+static bool flag_held;
+static bool clamp_open;
+static DIFF_DRIVE_NOISE noise;
+
+void diff_drive_init(ARENA *a, long long now_us) {
+    memset(motor, 0, sizeof(motor));
+    motor[DEVICE_CLAMP].low = -CLAMP_TRAVEL; // Opened with a negative speed
+    pose = a->start;
+    rate = 0;
+    arena = a;
+    model_start = model_now = now_us;
+    flag_held = false;
+    clamp_open = false;
+    memset(&noise, 0, sizeof(noise));
+    diff_drive_step(now_us); // So the sensors have a value
+}
+
+void diff_drive_set_noise(const DIFF_DRIVE_NOISE *n) { noise = *n; }
+
+/**
+ * @brief Get a random number between 0 and 1 (excluded)
+ */
+static double noise_uniform(void) {
+    return rand_r(&noise.seed) / ((double)RAND_MAX + 1);
+}
+
+/**
+ * @brief Get a random number of a normal distribution (Box-Muller)
+ *
+ * @param sd its standard deviation
+ */
+static double noise_normal(double sd) {
+    if (sd <= 0) {
+        return 0;
+    }
+    double u = 1 - noise_uniform(); // Not 0
+    return sd * sqrt(-2 * log(u)) * cos(2 * M_PI * noise_uniform());
+}
+
+/**
+ * @brief Stop a motor, as its stop_action says
+ *
+ * @param m the motor
+ * @param t its device
+ */
+static void motor_stop(MOTOR *m, const DEVICE_TACHO *t) {
+    m->running = false;
+    m->to_position = false;
+    m->end_us = 0;
+    m->holding = (t->stop_action == TACHO_HOLD);
+    m->hold = m->position;
+}
+
+void diff_drive_command(uint8_t sn) {
+    if (sn >= DEVICE_TACHO_COUNT) {
+        return;
+    }
+    MOTOR *m = &motor[sn];
+    DEVICE_TACHO *t = &device_tacho[sn];
+    switch (t->command) {
+    case TACHO_RUN_FOREVER:
+    case TACHO_RUN_DIRECT:
+    case TACHO_RUN_TIMED:
+        m->running = true;
+        m->holding = false;
+        m->to_position = false;
+        m->end_us = (t->command == TACHO_RUN_TIMED)
+                        ? model_now + (long long)t->time_sp * 1000
+                        : 0;
+        break;
+    case TACHO_RUN_TO_ABS_POS:
+    case TACHO_RUN_TO_REL_POS:
+        m->running = true;
+        m->holding = false;
+        m->to_position = true;
+        m->end_us = 0;
+        m->target = t->position_sp;
+        if (t->command == TACHO_RUN_TO_REL_POS) {
+            m->target += m->position;
+        }
+        break;
+    case TACHO_STOP:
+        motor_stop(m, t);
+        break;
+    case TACHO_RESET:
+        m->position = m->speed = m->published = 0;
+        m->running = m->to_position = m->holding = false;
+        m->end_us = 0;
+        t->position = 0;
+        t->speed_sp = t->time_sp = t->position_sp = 0;
+        t->ramp_up_sp = t->ramp_down_sp = 0;
+        t->stop_action = TACHO_COAST;
+        break;
+    }
+    // The state changes with the command, not at the next step
+    t->state = (m->running ? TACHO_RUNNING : 0) |
+               (m->holding ? TACHO_HOLDING : 0);
+}
+
+/**
+ * @brief Advance a motor
+ *
+ * @param m the motor
+ * @param t its device
+ * @param dt the time since the last step (s)
+ */
+static void motor_step(MOTOR *m, DEVICE_TACHO *t, double dt) {
+    if (t->position != m->published) { // Written by the program
+        m->position = t->position;
+    }
+    if (m->running && m->end_us && (model_now >= m->end_us)) {
+        motor_stop(m, t);
+    }
+
+    double max_speed = t->max_speed;
+    double desired = 0;
+    double tau = MOTOR_TAU;
+    if (m->running) {
+        double speed = fmin(fabs((double)t->speed_sp), max_speed);
+        if (m->to_position) {
+            double remaining = m->target - m->position;
+            if (fabs(remaining) < 0.5) {
+                motor_stop(m, t);
+            } else {
+                desired = copysign(
+                    fmin(speed, sqrt(2 * MOTOR_ACCEL * fabs(remaining))),
+                    remaining);
+            }
+        } else {
+            desired = fmax(-max_speed, fmin(max_speed, t->speed_sp));
+        }
+    }
+    if (!m->running) {
+        if (m->holding) {
+            desired = (m->hold - m->position) * HOLD_GAIN;
+        } else {
+            tau = (t->stop_action == TACHO_COAST) ? COAST_TAU : BRAKE_TAU;
+        }
+    }
+
+    double dv = (desired - m->speed) * fmin(1, dt / tau);
+    int ramp = (fabs(desired) > fabs(m->speed)) ? t->ramp_up_sp
+                                                 : t->ramp_down_sp;
+    bool ramping = false;
+    if (m->running && (ramp > 0)) { // ramp ms from 0 to max_speed
+        double limit = max_speed * 1000 / ramp * dt;
+        if (fabs(dv) > limit) {
+            dv = copysign(limit, dv);
+            ramping = true;
+        }
+    }
+    m->speed += dv;
+    m->position += m->speed * dt;
+    bool stalled = false;
+    if ((m->low < m->high) &&
+        ((m->position < m->low) || (m->position > m->high))) {
+        m->position = fmax(m->low, fmin(m->high, m->position));
+        m->speed = 0;
+        stalled = m->running || m->holding;
+    }
+
+    m->published = (int)lround(m->position);
+    t->position = m->published;
+    t->speed = (int)lround(m->speed);
+    t->state = (m->running ? TACHO_RUNNING : 0) |
+               (ramping ? TACHO_RAMPING : 0) |
+               (m->holding ? TACHO_HOLDING : 0) |
+               (stalled ? TACHO_STALLED : 0);
+}
+
+/**
+ * @brief Distance the sonar returns
+ * Rays are cast across the beam, the nearest echo that comes back is kept.
+ *
+ * @return double the distance (mm)
+ */
+static double sonar_range(void) {
+    double a = pose.heading * M_PI / 180;
+    double x = pose.x + SONAR_OFFSET * sin(a);
+    double y = pose.y + SONAR_OFFSET * cos(a);
+    double range = SONAR_MAX;
+    for (int i = 0; i < SONAR_RAYS; i++) {
+        double heading =
+            pose.heading + SONAR_CONE * ((double)i / (SONAR_RAYS - 1) - 0.5);
+        double incidence;
+        double d = arena_ray(arena, x, y, heading, &incidence);
+        if ((d >= 0) && (incidence <= SONAR_INCIDENCE)) {
+            range = fmin(range, d);
+        }
+    }
+    return fmax(0, range);
+}
+
+/**
+ * @brief Tell if the flag is where the clamp can take it
+ */
+static bool flag_in_reach(void) {
+    double a = pose.heading * M_PI / 180;
+    double fx = arena->flag_x - pose.x;
+    double fy = arena->flag_y - pose.y;
+    double forward = fx * sin(a) + fy * cos(a);
+    double side = fx * cos(a) - fy * sin(a);
+    return (forward >= FLAG_REACH_MIN) && (forward <= FLAG_REACH_MAX) &&
+           (fabs(side) <= FLAG_REACH_SIDE);
+}
+
+/**
+ * @brief The clamp takes the flag when it closes on it, and drops it when it
+ * opens
+ */
+static void flag_step(void) {
+    double position = motor[DEVICE_CLAMP].position;
+    if (clamp_open && (position > -CLAMP_TRAVEL / 4)) {
+        clamp_open = false;
+        flag_held = flag_in_reach();
+    } else if (!clamp_open && (position < -CLAMP_TRAVEL / 2)) {
+        clamp_open = true;
+        flag_held = false;
+    }
+    if (flag_held) {
+        double a = pose.heading * M_PI / 180;
+        arena->flag_x = pose.x + FLAG_HELD * sin(a);
+        arena->flag_y = pose.y + FLAG_HELD * cos(a);
+    }
+}
+
+/**
+ * @brief Move the robot, unless it would go in a wall or in the opponent
+ * The wheels slip, it slides along what it hits if it can.
+ */
+static void move_to(double x, double y) {
+    if (!arena_collides(arena, x, y, ROBOT_RADIUS)) {
+        pose.x = x;
+        pose.y = y;
+    } else if (!arena_collides(arena, x, pose.y, ROBOT_RADIUS)) {
+        pose.x = x;
+    } else if (!arena_collides(arena, pose.x, y, ROBOT_RADIUS)) {
+        pose.y = y;
+    }
+}
+
+void diff_drive_step(long long now_us) {
+    double dt = (now_us - model_now) / 1e6;
+    model_now = now_us;
+    arena_step(arena, now_us - model_start);
+    for (int sn = 0; sn < DEVICE_TACHO_COUNT; sn++) {
+        motor_step(&motor[sn], &device_tacho[sn], dt);
+    }
+
+    // Speed of the wheels on the ground (mm / s)
+    double mm_per_count[2];
+    for (int i = 0; i < 2; i++) {
+        mm_per_count[i] = 2 * M_PI * WHEEL_RADIUS /
+                          device_tacho[DEVICE_WHEEL_LEFT + i].count_per_rot;
+    }
+    double left = motor[DEVICE_WHEEL_LEFT].speed * mm_per_count[0];
+    double right = motor[DEVICE_WHEEL_RIGHT].speed * mm_per_count[1];
+    double v = (left + right) / 2;
+    rate = (left - right) / AXLE * 180 / M_PI;
+
+    double a = (pose.heading + rate * dt / 2) * M_PI / 180; // Middle of step
+    pose.heading += rate * dt;
+    move_to(pose.x + v * dt * sin(a), pose.y + v * dt * cos(a));
+    flag_step();
+
+    // What the gyro measures, with its drift
+    double angle =
+        pose.heading + noise.gyro_drift * (now_us - model_start) / 1e6;
+    double gyro_rate = rate + noise.gyro_drift + noise_normal(noise.gyro_sd);
+    DEVICE_SENSOR *gyro = &device_sensor[DEVICE_GYRO];
+    if (strcmp(gyro->mode, "GYRO-G&A") == 0) {
+        gyro->values.count = 2;
+        gyro->values.value[0] = lround(angle);
+        gyro->values.value[1] = lround(gyro_rate);
+    } else {
+        gyro->values.count = 1;
+        gyro->values.value[0] = (strcmp(gyro->mode, "GYRO-RATE") == 0)
+                                    ? lround(gyro_rate)
+                                    : lround(angle);
+    }
+    double range = sonar_range() + noise_normal(noise.sonar_sd);
+    if ((noise.sonar_spike > 0) && (noise_uniform() < noise.sonar_spike)) {
+        range = SONAR_MAX;
+    }
+    DEVICE_SENSOR *sonar = &device_sensor[DEVICE_SONAR];
+    sonar->values.count = 1;
+    sonar->values.value[0] = lround(fmax(0, fmin(SONAR_MAX, range)));
+    DEVICE_SENSOR *color = &device_sensor[DEVICE_COLOR];
+    color->values.count = 1;
+    // The flag in front of the sensor hides the floor
+    color->values.value[0] = flag_in_reach() ? 0 : arena->floor_color;
+}
+
+void diff_drive_get_pose(POSE *p) { *p = pose; }
+
+bool diff_drive_flag_held(void) { return flag_held; }
@@ -0,0 +1,75 @@
+#ifndef DIFF_DRIVE_H
+#define DIFF_DRIVE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+/*
+ * Physics of the robot: the tachos of tools/devices.h follow their commands
+ * (run-forever, run-timed, run-to-*-pos, stop with its stop_action, ramps),
+ * the two wheels move the robot as a differential drive in the arena of
+ * tools/arena.h, and the sensors see the result: the gyro integrates the
+ * rotation of the wheels, the sonar casts rays across its beam, the color
+ * sensor sees the flag when it is in the clamp.
+ *
+ * The clamp (DEVICE_CLAMP) opens with a negative speed and stalls at its
+ * stops. It takes the flag when it closes with the flag in front of it.
+ */
+
+/**
+ * @brief What the sensors get wrong
+ */
+typedef struct {
+    unsigned seed;      // Of the random numbers, the same seed gives the same
+    double sonar_sd;    // Standard deviation of the sonar (mm)
+    double sonar_spike; // Probability a sonar read sees nothing (SONAR_MAX)
+    double gyro_drift;  // Drift of the gyro (degrees / s)
+    double gyro_sd;     // Standard deviation of the rate of the gyro
+} DIFF_DRIVE_NOISE;
+
+/**
+ * @brief Start the model, the robot at the start of the arena
+ *
+ * @param arena the arena, it must stay valid and the model moves the flag and
+ * the opponent in it
+ * @param now_us the time of the clock
+ */
+void diff_drive_init(ARENA *arena, long long now_us);
+
+/**
+ * @brief Make the sensors noisy, they are exact by default
+ * Call it after diff_drive_init.
+ *
+ * @param noise the noise
+ */
+void diff_drive_set_noise(const DIFF_DRIVE_NOISE *noise);
+
+/**
+ * @brief A command was written to a tacho
+ *
+ * @param sn the tacho
+ */
+void diff_drive_command(uint8_t sn);
+
+/**
+ * @brief Advance the model to a time, and update the devices
+ *
+ * @param now_us the time of the clock
+ */
+void diff_drive_step(long long now_us);
+
+/**
+ * @brief Get the position of the robot
+ *
+ * @param pose where to store it
+ */
+void diff_drive_get_pose(POSE *pose);
+
+/**
+ * @brief Tell if the clamp holds the flag
+ */
+bool diff_drive_flag_held(void);
+
+#endif /* DIFF_DRIVE_H */
@@ -0,0 +1,206 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../include/ev3.h"
+#include "../src/clock.h"
+#include "ev3_udp.h"
+
+/*
+ * The remote calls of include/ev3.h over the messages of ev3_udp.h, as the
+ * client mode of ev3dev-c does them: one request at a time, the caller waits
+ * for its reply. Only the calls that go on the network are here, the bench
+ * links this file when the sources of the library are not there (see
+ * EV3_LINK_SRC in the makefile).
+ */
+
+#define LINK_TIMEOUT_MS 200
+#define LINK_DETECT_MS (3 * EV3_UDP_ANNOUNCE_MS)
+
+char *ev3_brick_addr = NULL;
+uint16_t ev3_brick_port = EV3_UDP_PORT;
+
+static int link_fd = -1;
+static uint16_t next_id = 0;
+static char brick_addr[INET_ADDRSTRLEN]; // Found by ev3_init
+
+/**
+ * @brief Wait for the brick to announce itself
+ *
+ * @param addr where to store its address
+ * @return bool false if it was not heard in LINK_DETECT_MS
+ */
+static bool link_detect(struct in_addr *addr) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int on = 1;
+    struct sockaddr_in local = {0};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(EV3_UDP_ANNOUNCE_PORT);
+    if ((fd < 0) ||
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) ||
+        bind(fd, (struct sockaddr *)&local, sizeof(local))) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    bool found = false;
+    long long end = clock_now_us() + LINK_DETECT_MS * 1000LL;
+    struct pollfd p = {fd, POLLIN, 0};
+    long long now;
+    while (!found && ((now = clock_now_us()) < end) &&
+           (poll(&p, 1, (end - now) / 1000 + 1) > 0)) {
+        char msg[EV3_UDP_SIZE];
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(fd, msg, sizeof(msg), 0,
+                             (struct sockaddr *)&from, &from_len);
+        EV3_UDP_HEADER h;
+        if (n >= (ssize_t)sizeof(h)) {
+            memcpy(&h, msg, sizeof(h));
+            found = (h.command == EV3_UDP_BRICK);
+            *addr = from.sin_addr;
+        }
+    }
+    close(fd);
+    return found;
+}
+
+int ev3_init(void) {
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(ev3_brick_port);
+    int found = 0;
+    if (ev3_brick_addr) {
+        if (inet_pton(AF_INET, ev3_brick_addr, &addr.sin_addr) != 1) {
+            return -1;
+        }
+    } else if (link_detect(&addr.sin_addr)) {
+        inet_ntop(AF_INET, &addr.sin_addr, brick_addr, sizeof(brick_addr));
+        ev3_brick_addr = brick_addr;
+        found = 1;
+    } else {
+        return 0;
+    }
+    link_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if ((link_fd < 0) ||
+        connect(link_fd, (struct sockaddr *)&addr, sizeof(addr))) {
+        ev3_uninit();
+        return -1;
+    }
+    return found;
+}
+
+void ev3_uninit(void) {
+    if (link_fd >= 0) {
+        close(link_fd);
+    }
+    link_fd = -1;
+}
+
+/**
+ * @brief Send a request and wait for its reply
+ *
+ * @param command EV3_UDP_*
+ * @param size the size field of the header
+ * @param data the data of the request
+ * @param len the size of the data
+ * @param buf where to copy the data of the reply, can be NULL
+ * @param sz the size of buf
+ * @return int the size field of the reply, < 0 if it failed or did not come
+ */
+static int link_request(uint8_t command, uint16_t size, const void *data,
+                        size_t len, void *buf, size_t sz) {
+    char msg[EV3_UDP_SIZE];
+    EV3_UDP_HEADER h = {++next_id, command, 0, size};
+    if ((link_fd < 0) || (sizeof(h) + len > sizeof(msg))) {
+        return -1;
+    }
+    memcpy(msg, &h, sizeof(h));
+    if (len) {
+        memcpy(msg + sizeof(h), data, len);
+    }
+    if (send(link_fd, msg, sizeof(h) + len, 0) < 0) {
+        return -1;
+    }
+    struct pollfd p = {link_fd, POLLIN, 0};
+    while (poll(&p, 1, LINK_TIMEOUT_MS) > 0) {
+        EV3_UDP_HEADER reply;
+        ssize_t n = recv(link_fd, msg, sizeof(msg), 0);
+        if (n < (ssize_t)sizeof(reply)) {
+            continue;
+        }
+        memcpy(&reply, msg, sizeof(reply));
+        if (reply.id != h.id) {
+            continue; // Reply of a request that timed out, wait for ours
+        }
+        if (reply.status != 0) {
+            return -1;
+        }
+        size_t got = n - sizeof(reply);
+        if (buf) {
+            memcpy(buf, msg + sizeof(reply), (got < sz) ? got : sz);
+        }
+        return reply.size;
+    }
+    return -1;
+}
+
+size_t ev3_write_binary(const char *fn, char *data, size_t sz) {
+    char msg[EV3_UDP_SIZE];
+    size_t len = strlen(fn) + 1;
+    if (len + sz > sizeof(msg)) {
+        return 0;
+    }
+    memcpy(msg, fn, len);
+    memcpy(msg + len, data, sz);
+    int n = link_request(EV3_UDP_WRITE, sz, msg, len + sz, NULL, 0);
+    return (n < 0) ? 0 : n;
+}
+
+size_t ev3_multi_write_binary(uint8_t *sn, uint16_t pos, const char *fn,
+                              char *data, size_t sz) {
+    char msg[EV3_UDP_SIZE];
+    uint8_t count = 0;
+    while ((count < DESC_LIMIT) && (sn[count] != DESC_LIMIT)) {
+        count++;
+    }
+    size_t path = strlen(fn) + 1;
+    size_t len = 1 + count + sizeof(pos);
+    if (len + path + sz > sizeof(msg)) {
+        return 0;
+    }
+    msg[0] = count;
+    memcpy(msg + 1, sn, count);
+    memcpy(msg + 1 + count, &pos, sizeof(pos));
+    memcpy(msg + len, fn, path);
+    len += path;
+    memcpy(msg + len, data, sz);
+    len += sz;
+    int n = link_request(EV3_UDP_MULTI_WRITE, sz, msg, len, NULL, 0);
+    return (n < 0) ? 0 : n;
+}
+
+size_t ev3_read_binary(const char *fn, char *buf, size_t sz) {
+    int n = link_request(EV3_UDP_READ, sz, fn, strlen(fn) + 1, buf, sz);
+    return (n < 0) ? 0 : n;
+}
+
+size_t ev3_listdir(const char *fn, char *buf, size_t sz) {
+    int n = link_request(EV3_UDP_LISTDIR, sz, fn, strlen(fn) + 1, buf, sz);
+    return (n < 0) ? 0 : n;
+}
+
+size_t ev3_read_keys(uint8_t *buf) {
+    int n = link_request(EV3_UDP_KEYS, 1, NULL, 0, buf, 1);
+    return (n < 0) ? 0 : n;
+}
+
+bool ev3_poweroff(void) {
+    return link_request(EV3_UDP_POWEROFF, 0, NULL, 0, NULL, 0) >= 0;
+}
@@ -0,0 +1,273 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/ev3_sensor.h"
+#include "../include/ev3_tacho.h"
+#include "../src/clock.h"
+#include "../src/ev3_attr.h"
+#include "devices.h"
+#include "diff_drive.h"
+
+/*
+ * Simulator of the robot: make a sysfs tree with the attribute files of its
+ * sensors and tachos, and keep it up to date from the physics of
+ * tools/diff_drive.c. The program of the robot, built for the computer, runs
+ * on it unmodified:
+ *   bin/ev3_simd /dev/shm/ev3sim &
+ *   EV3_SYSFS_ROOT=/dev/shm/ev3sim bin/project_os_host
+ *
+ * Every SIMD_PERIOD_US the files the program can write are read back (a
+ * command is consumed, the file is emptied), the model is advanced, and the
+ * files whose value changed are rewritten in place (the program keeps them
+ * open). Unlike sysfs a read can see a value while it is being rewritten,
+ * which does not matter at this rate.
+ *
+ * Usage: ev3_simd [-v] [root]
+ */
+
+#define SIMD_ROOT "/dev/shm/ev3sim"
+#define SIMD_PERIOD_US 1000
+#define SIMD_PRINT_US 500000 // Period of the position printed with -v
+
+
+typedef struct {
+    int fd;
+    char last[64]; // What was last written in the file
+    size_t len;
+} SIMD_FILE;
+
+static SIMD_FILE files[EV3_ATTR_CLASS_COUNT][DEVICE_SENSOR_COUNT +
+                                            DEVICE_TACHO_COUNT]
+                      [EV3_ATTR_COUNT];
+
+static const int sensor_attr[] = {
+    EV3_ATTR_ADDRESS,  EV3_ATTR_DRIVER_NAME, EV3_ATTR_MODE,
+    EV3_ATTR_NUM_VALUES, EV3_ATTR_DECIMALS,  EV3_ATTR_BIN_DATA,
+    EV3_ATTR_BIN_DATA_FORMAT, EV3_ATTR_VALUE0, EV3_ATTR_VALUE1,
+    EV3_ATTR_VALUE2,   EV3_ATTR_VALUE3,     EV3_ATTR_VALUE4,
+    EV3_ATTR_VALUE5,   EV3_ATTR_VALUE6,     EV3_ATTR_VALUE7,
+};
+
+static const int tacho_attr[] = {
+    EV3_ATTR_ADDRESS,      EV3_ATTR_DRIVER_NAME, EV3_ATTR_COMMAND,
+    EV3_ATTR_COUNT_PER_ROT, EV3_ATTR_MAX_SPEED,  EV3_ATTR_POSITION,
+    EV3_ATTR_POSITION_SP,  EV3_ATTR_RAMP_DOWN_SP, EV3_ATTR_RAMP_UP_SP,
+    EV3_ATTR_SPEED,        EV3_ATTR_SPEED_SP,    EV3_ATTR_STATE,
+    EV3_ATTR_STOP_ACTION,  EV3_ATTR_TIME_SP,
+};
+
+#define SENSOR_ATTR_COUNT ((int)(sizeof(sensor_attr) / sizeof(sensor_attr[0])))
+#define TACHO_ATTR_COUNT ((int)(sizeof(tacho_attr) / sizeof(tacho_attr[0])))
+
+static ARENA arena;
+static volatile sig_atomic_t quit = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    quit = 1;
+}
+
+/**
+ * @brief Tell if the program can write an attribute
+ */
+static bool writable(int cls, int attr) {
+    if (cls == EV3_ATTR_SENSOR) {
+        return attr == EV3_ATTR_MODE;
+    }
+    switch (attr) {
+    case EV3_ATTR_COMMAND:
+    case EV3_ATTR_POSITION:
+    case EV3_ATTR_POSITION_SP:
+    case EV3_ATTR_RAMP_DOWN_SP:
+    case EV3_ATTR_RAMP_UP_SP:
+    case EV3_ATTR_SPEED_SP:
+    case EV3_ATTR_STOP_ACTION:
+    case EV3_ATTR_TIME_SP:
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Create a directory and its parents
+ *
+ * @param path the directory
+ * @return int 0 if it exists
+ */
+static int mkdir_p(const char *path) {
+    char tmp[256];
+    snprintf(tmp, sizeof(tmp), "%s", path);
+    for (char *p = tmp + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            if (mkdir(tmp, 0755) && (errno != EEXIST)) {
+                return -1;
+            }
+            *p = '/';
+        }
+    }
+    return (mkdir(tmp, 0755) && (errno != EEXIST)) ? -1 : 0;
+}
+
+/**
+ * @brief Write the value of an attribute in its file if it changed
+ */
+static void sync_out(int cls, int sn, int attr) {
+    SIMD_FILE *f = &files[cls][sn][attr];
+    char s[sizeof(f->last)];
+    size_t len;
+    if ((cls == EV3_ATTR_SENSOR) && (attr == EV3_ATTR_BIN_DATA)) {
+        len = device_sensor[sn].values.count * sizeof(float);
+        memcpy(s, device_sensor[sn].values.value, len);
+    } else if (device_attr_format(cls, sn, attr, s, sizeof(s) - 1)) {
+        len = strlen(s);
+        if ((attr != EV3_ATTR_COMMAND) || len) { // Else an empty file
+            s[len++] = '\n';
+        }
+    } else {
+        len = 0; // valueN above num_values
+    }
+    if ((len == f->len) && (memcmp(s, f->last, len) == 0)) {
+        return;
+    }
+    if ((pwrite(f->fd, s, len, 0) != (ssize_t)len) || ftruncate(f->fd, len)) {
+        perror("ev3_simd: write");
+    }
+    memcpy(f->last, s, len);
+    f->len = len;
+}
+
+/**
+ * @brief Read what the program wrote in an attribute
+ */
+static void sync_in(int cls, int sn, int attr) {
+    SIMD_FILE *f = &files[cls][sn][attr];
+    char s[sizeof(f->last)];
+    ssize_t n = pread(f->fd, s, sizeof(s) - 1, 0);
+    if ((n <= 0) || (((size_t)n == f->len) && !memcmp(s, f->last, n))) {
+        return; // Not written since we did
+    }
+    while ((n > 0) && (s[n - 1] == '\n')) {
+        n--;
+    }
+    s[n] = '\0';
+    if (device_attr_parse(cls, sn, attr, s) && (cls == EV3_ATTR_TACHO) &&
+        (attr == EV3_ATTR_COMMAND)) {
+        diff_drive_command(sn);
+    }
+    f->len = (size_t)-1; // Rewritten by sync_out, even if the value is equal
+}
+
+/**
+ * @brief Create the files of a device
+ *
+ * @param root the root of the tree
+ * @param cls the class of the device
+ * @param sn the device
+ * @return int 0 if they were created
+ */
+static int create_device(const char *root, int cls, int sn) {
+    char dir[256];
+    char path[320];
+    if (cls == EV3_ATTR_SENSOR) {
+        snprintf(dir, sizeof(dir), "%s" SENSOR_DIR "/sensor%d", root, sn);
+    } else {
+        snprintf(dir, sizeof(dir), "%s" TACHO_DIR "/motor%d", root, sn);
+    }
+    if (mkdir_p(dir)) {
+        perror(dir);
+        return -1;
+    }
+    const int *attrs = (cls == EV3_ATTR_SENSOR) ? sensor_attr : tacho_attr;
+    int count = (cls == EV3_ATTR_SENSOR) ? SENSOR_ATTR_COUNT : TACHO_ATTR_COUNT;
+    for (int i = 0; i < count; i++) {
+        SIMD_FILE *f = &files[cls][sn][attrs[i]];
+        snprintf(path, sizeof(path), "%s/%s", dir, ev3_attr_name(attrs[i]));
+        f->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (f->fd < 0) {
+            perror(path);
+            return -1;
+        }
+        f->len = (size_t)-1;
+        sync_out(cls, sn, attrs[i]);
+    }
+    return 0;
+}
+
+/**
+ * @brief Synchronize every file of every device
+ *
+ * @param in read what the program wrote, else write the values
+ */
+static void sync_all(bool in) {
+    for (int cls = 0; cls < EV3_ATTR_CLASS_COUNT; cls++) {
+        const int *attrs = (cls == EV3_ATTR_SENSOR) ? sensor_attr : tacho_attr;
+        int count =
+            (cls == EV3_ATTR_SENSOR) ? SENSOR_ATTR_COUNT : TACHO_ATTR_COUNT;
+        for (int sn = 0; sn < devices_count(cls); sn++) {
+            for (int i = 0; i < count; i++) {
+                if (!in) {
+                    sync_out(cls, sn, attrs[i]);
+                } else if (writable(cls, attrs[i])) {
+                    sync_in(cls, sn, attrs[i]);
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    bool verbose = false;
+    const char *root = SIMD_ROOT;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else if (argv[i][0] != '-') {
+            root = argv[i];
+        } else {
+            fprintf(stderr, "Usage: %s [-v] [root]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    long long now = clock_now_us();
+    arena_default(&arena);
+    devices_reset();
+    diff_drive_init(&arena, now);
+    for (int cls = 0; cls < EV3_ATTR_CLASS_COUNT; cls++) {
+        for (int sn = 0; sn < devices_count(cls); sn++) {
+            if (create_device(root, cls, sn)) {
+                return 2;
+            }
+        }
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    printf("Simulating the robot in %s\n", root);
+
+    long long next = now;
+    long long print = now;
+    while (!quit) {
+        next += SIMD_PERIOD_US;
+        clock_sleep_until_us(next);
+        now = clock_now_us();
+        sync_all(true);
+        diff_drive_step(now);
+        sync_all(false);
+        if (verbose && (now >= print)) {
+            POSE pose;
+            diff_drive_get_pose(&pose);
+            printf("x %6.0f y %6.0f heading %6.1f\n", pose.x, pose.y,
+                   pose.heading);
+            print = now + SIMD_PRINT_US;
+        }
+    }
+    return 0;
+}
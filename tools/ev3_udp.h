@@ -0,0 +1,66 @@
+#ifndef EV3_UDP_H
+#define EV3_UDP_H
+
+#include <stdint.h>
+
+/*
+ * Messages of the client mode of ev3dev-c: when it is not built for the
+ * brick, the library sends every sysfs access to ev3_brick_addr :
+ * ev3_brick_port in UDP, and the brick answers with the result.
+ *
+ * The layout below is what tools/ev3_udpd and tools/ev3_link speak, for every
+ * remote call of include/ev3.h (ev3_init, read, write, multi write, listdir,
+ * keys, poweroff). When the submodule is checked out, bin/ev3_udp_bench is
+ * built on the client of the library (ev3dev-c/source/ev3/ev3.c) and not on
+ * tools/ev3_link.c, so it runs the real transport against ev3_udpd: a layout
+ * that differs from the one of the library shows as failed requests.
+ *
+ * A message is a header followed by its data, all little endian:
+ * - EV3_UDP_BRICK: sent by the brick to the broadcast address on
+ *   EV3_UDP_ANNOUNCE_PORT every EV3_UDP_ANNOUNCE_MS, data is its name.
+ *   ev3_init without ev3_brick_addr waits for it and takes its sender.
+ * - EV3_UDP_READ: path (with its '\0'), size is the maximum to read.
+ *   Reply: the content of the file.
+ * - EV3_UDP_WRITE: path, then the value, size is the size of the value.
+ *   Reply: no data, size is the number of bytes written.
+ * - EV3_UDP_LISTDIR: path, size is the maximum to read.
+ *   Reply: the names in the directory, each ended by '\0'.
+ * - EV3_UDP_MULTI_WRITE: count, count sn, pos (uint16_t), path, then the
+ *   value. The sn is written at pos in the path ("/sys/.../motor" with pos
+ *   at its end). Reply: no data, size is the number of bytes written.
+ * - EV3_UDP_KEYS: no data. Reply: one byte, the keys pressed (EV3_KEY_*).
+ * - EV3_UDP_POWEROFF: no data. Reply: no data, then the brick stops.
+ * The reply has the id and command of the request, status is 0 if it
+ * succeeded.
+ */
+
+#define EV3_UDP_PORT 8800
+#define EV3_UDP_ANNOUNCE_PORT 8801 // Another port, to run both on a computer
+#define EV3_UDP_ANNOUNCE_MS 1000
+#define EV3_UDP_SIZE 1024 // Largest message
+
+enum {
+    EV3_UDP_BRICK = 0,
+    EV3_UDP_READ,
+    EV3_UDP_WRITE,
+    EV3_UDP_LISTDIR,
+    EV3_UDP_MULTI_WRITE,
+    EV3_UDP_KEYS,
+    EV3_UDP_POWEROFF,
+
+    EV3_UDP_COMMAND_COUNT,
+};
+
+/**
+ * @brief Header of a request and of its reply
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t id;     // Chosen by the client, copied in the reply
+    uint8_t command; // EV3_UDP_*
+    uint8_t status;  // 0 in a request, 0 if it succeeded in a reply
+    uint16_t size;   // See above
+} EV3_UDP_HEADER;
+
+_Static_assert(sizeof(EV3_UDP_HEADER) == 6, "layout of the messages");
+
+#endif /* EV3_UDP_H */
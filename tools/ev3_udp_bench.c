@@ -0,0 +1,157 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/ev3.h"
+#include "../include/ev3_sensor.h"
+#include "../include/ev3_tacho.h"
+#include "../src/clock.h"
+#include "../src/instr.h"
+
+/*
+ * Measure the round trip time of the requests of a control tick in the client
+ * mode: read the sonar, the gyro and a wheel, write a speed and start both
+ * wheels. Only the calls of include/ev3.h are used, so the bench measures
+ * whichever client it is linked with: the client mode of ev3dev-c when its
+ * sources are there, else tools/ev3_link.c (see EV3_LINK_SRC in the makefile).
+ *
+ * Without -h the brick is found by ev3_init, -o powers it off at the end.
+ *
+ * Usage: ev3_udp_bench [-n ticks] [-h address] [-p port] [-o]
+ */
+
+enum {
+    BENCH_SONAR = 0,
+    BENCH_GYRO,
+    BENCH_POSITION,
+    BENCH_SPEED_SP,
+    BENCH_COMMAND,
+    BENCH_TICK, // The whole tick
+
+    BENCH_COUNT,
+};
+
+static const char *bench_name[BENCH_COUNT] = {
+    "sonar", "gyro", "position", "speed_sp", "command", "tick",
+};
+
+static INSTR_HIST rtt[BENCH_COUNT];
+static unsigned long failed = 0;
+
+/**
+ * @brief Read a file, and account the time it took
+ */
+static void bench_read(int id, const char *path) {
+    char buf[64];
+    long long start = clock_now_us();
+    if (ev3_read_binary(path, buf, sizeof(buf))) {
+        instr_hist_add(&rtt[id], clock_now_us() - start);
+    } else {
+        failed++;
+    }
+}
+
+/**
+ * @brief Write a file, and account the time it took
+ */
+static void bench_write(int id, const char *path, char *value) {
+    long long start = clock_now_us();
+    if (ev3_write_binary(path, value, strlen(value))) {
+        instr_hist_add(&rtt[id], clock_now_us() - start);
+    } else {
+        failed++;
+    }
+}
+
+/**
+ * @brief Write a file of several tachos, and account the time it took
+ *
+ * @param sn the tachos, ended by DESC_LIMIT
+ */
+static void bench_multi_write(int id, uint8_t *sn, const char *attr,
+                              char *value) {
+    char path[64];
+    uint16_t pos = snprintf(path, sizeof(path), TACHO_DIR "/motor");
+    snprintf(path + pos, sizeof(path) - pos, "/%s", attr);
+    long long start = clock_now_us();
+    if (ev3_multi_write_binary(sn, pos, path, value, strlen(value))) {
+        instr_hist_add(&rtt[id], clock_now_us() - start);
+    } else {
+        failed++;
+    }
+}
+
+int main(int argc, char **argv) {
+    int ticks = 1000;
+    bool poweroff = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:h:p:o")) != -1) {
+        switch (opt) {
+        case 'n':
+            ticks = atoi(optarg);
+            break;
+        case 'h':
+            ev3_brick_addr = optarg;
+            break;
+        case 'p':
+            ev3_brick_port = atoi(optarg);
+            break;
+        case 'o':
+            poweroff = true;
+            break;
+        default:
+            fprintf(stderr,
+                    "Usage: %s [-n ticks] [-h address] [-p port] [-o]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    bool detect = !ev3_brick_addr;
+    long long start = clock_now_us();
+    int found = ev3_init();
+    if ((found < 0) || (detect && !found)) {
+        fprintf(stderr, "ev3_udp_bench: no brick\n");
+        return 2;
+    }
+    if (detect) {
+        printf("Brick found at %s in %lld ms\n", ev3_brick_addr,
+               (clock_now_us() - start) / 1000);
+    }
+    uint8_t keys = 0;
+    if (!ev3_read_keys(&keys)) {
+        failed++;
+    }
+    printf("Keys 0x%02x\n", keys);
+
+    uint8_t wheels[] = {0, 1, DESC_LIMIT};
+    for (int i = 0; i < ticks; i++) {
+        start = clock_now_us();
+        bench_read(BENCH_SONAR, SENSOR_DIR "/sensor0/bin_data");
+        bench_read(BENCH_GYRO, SENSOR_DIR "/sensor1/bin_data");
+        bench_read(BENCH_POSITION, TACHO_DIR "/motor0/position");
+        bench_write(BENCH_SPEED_SP, TACHO_DIR "/motor0/speed_sp",
+                    (i & 1) ? "200" : "210");
+        bench_multi_write(BENCH_COMMAND, wheels, "command",
+                          (i + 1 < ticks) ? "run-forever" : "stop");
+        instr_hist_add(&rtt[BENCH_TICK], clock_now_us() - start);
+    }
+
+    printf("%-10s %8s %8s %8s %8s %8s\n", "us", "count", "mean", "p50", "p99",
+           "max");
+    for (int id = 0; id < BENCH_COUNT; id++) {
+        INSTR_HIST *h = &rtt[id];
+        printf("%-10s %8lu %8lld %8lld %8lld %8lld\n", bench_name[id],
+               h->count, h->count ? h->sum / (long long)h->count : 0,
+               instr_hist_percentile(h, 50), instr_hist_percentile(h, 99),
+               h->max);
+    }
+    printf("%lu requests failed\n", failed);
+    if (poweroff && !ev3_poweroff()) {
+        printf("The brick did not answer the poweroff\n");
+    }
+    ev3_uninit();
+    return 0;
+}
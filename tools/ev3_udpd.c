@@ -0,0 +1,496 @@
+#define _GNU_SOURCE // ppoll
+#include <arpa/inet.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../include/ev3_sensor.h"
+#include "../include/ev3_tacho.h"
+#include "../src/clock.h"
+#include "../src/ev3_attr.h"
+#include "../src/instr.h"
+#include "devices.h"
+#include "diff_drive.h"
+#include "ev3_udp.h"
+
+/*
+ * Stand-in for the brick in the client mode of ev3dev-c: answer the UDP
+ * requests (see ev3_udp.h) with the devices of the simulated robot
+ * (tools/diff_drive.c), advanced in real time.
+ *
+ * The replies can be delayed, to see how the program behaves with the
+ * latency of the wifi: -l the delay (ms), -j a random jitter added to it
+ * (ms). The time between the reception of a request and the sending of its
+ * reply is measured, and printed by command at the end (Ctrl-C, or a
+ * poweroff request).
+ *
+ * The brick is announced to -b (the broadcast address by default) so that
+ * ev3_init finds it, and -k gives the keys it reports as pressed (EV3_KEY_*).
+ *
+ * Usage: ev3_udpd [-p port] [-b address] [-k keys] [-l latency] [-j jitter]
+ *                 [-v]
+ */
+
+#define UDPD_STEP_US 1000  // Period of the model
+#define UDPD_PENDING 256   // Replies that can wait for their delay
+#define UDPD_PRINT_US 500000
+
+
+typedef struct {
+    long long due_us;  // When to send it
+    long long rx_us;   // When the request was received
+    uint8_t command;
+    struct sockaddr_in to;
+    size_t len;
+    char msg[EV3_UDP_SIZE];
+} UDPD_REPLY;
+
+static UDPD_REPLY pending[UDPD_PENDING];
+static int pending_count = 0;
+
+static INSTR_HIST service[EV3_UDP_COMMAND_COUNT]; // Time to answer (us)
+static INSTR_HIST total[EV3_UDP_COMMAND_COUNT];   // With the delay (us)
+static unsigned long refused = 0;                 // Bad requests
+static unsigned long dropped = 0;                 // Too many pending
+
+static const char *command_name[EV3_UDP_COMMAND_COUNT] = {
+    [EV3_UDP_BRICK] = "other", // Never asked, the unknown commands
+    [EV3_UDP_READ] = "read",
+    [EV3_UDP_WRITE] = "write",
+    [EV3_UDP_LISTDIR] = "listdir",
+    [EV3_UDP_MULTI_WRITE] = "multi_write",
+    [EV3_UDP_KEYS] = "keys",
+    [EV3_UDP_POWEROFF] = "poweroff",
+};
+
+static uint8_t keys = 0;        // Reported as pressed
+static bool powered_off = false; // Quit once the replies are sent
+
+static ARENA arena;
+static volatile sig_atomic_t quit = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    quit = 1;
+}
+
+/**
+ * @brief Find the attribute of a sysfs path
+ *
+ * @param path the path ("/sys/class/tacho-motor/motor0/speed_sp", ...)
+ * @param cls where to store the class of the device
+ * @param sn where to store the sequence number of the device
+ * @param attr where to store the attribute
+ * @return bool false if it is not the path of an attribute of a device
+ */
+static bool udpd_path_parse(const char *path, int *cls, uint8_t *sn,
+                            int *attr) {
+    static const char *dir[EV3_ATTR_CLASS_COUNT] = {
+        [EV3_ATTR_SENSOR] = SENSOR_DIR "/sensor",
+        [EV3_ATTR_TACHO] = TACHO_DIR "/motor",
+    };
+    for (int c = 0; c < EV3_ATTR_CLASS_COUNT; c++) {
+        size_t len = strlen(dir[c]);
+        if (strncmp(path, dir[c], len) != 0) {
+            continue;
+        }
+        char *end;
+        long n = strtol(path + len, &end, 10);
+        if ((end == path + len) || (*end != '/') || (n < 0) ||
+            (n >= devices_count(c))) {
+            return false;
+        }
+        for (int a = 0; a < EV3_ATTR_COUNT; a++) {
+            if (strcmp(end + 1, ev3_attr_name(a)) == 0) {
+                *cls = c;
+                *sn = n;
+                *attr = a;
+                return true;
+            }
+        }
+        return false;
+    }
+    return false;
+}
+
+/**
+ * @brief Read an attribute of a device
+ *
+ * @param path the path of the attribute
+ * @param buf where to put the content
+ * @param sz the maximum to read
+ * @return int the size read, < 0 if error
+ */
+static int udpd_read(const char *path, char *buf, size_t sz) {
+    int cls;
+    uint8_t sn;
+    int attr;
+    char s[64];
+    if (!udpd_path_parse(path, &cls, &sn, &attr)) {
+        return -1;
+    }
+    size_t len;
+    if ((cls == EV3_ATTR_SENSOR) && (attr == EV3_ATTR_BIN_DATA)) {
+        len = device_sensor[sn].values.count * sizeof(float);
+        memcpy(s, device_sensor[sn].values.value, len);
+    } else if (device_attr_format(cls, sn, attr, s, sizeof(s) - 1)) {
+        len = strlen(s);
+        s[len++] = '\n';
+    } else {
+        return -1;
+    }
+    len = (len < sz) ? len : sz;
+    memcpy(buf, s, len);
+    return len;
+}
+
+/**
+ * @brief Write an attribute of a device
+ *
+ * @param path the path of the attribute
+ * @param value the value, not ended by '\0'
+ * @param len the size of the value
+ * @return int the size written, < 0 if error
+ */
+static int udpd_write(const char *path, const char *value, size_t len) {
+    int cls;
+    uint8_t sn;
+    int attr;
+    char s[64];
+    if (!udpd_path_parse(path, &cls, &sn, &attr) || (len >= sizeof(s))) {
+        return -1;
+    }
+    memcpy(s, value, len);
+    s[len] = '\0';
+    while ((len > 0) && (s[len - 1] == '\n')) {
+        s[--len] = '\0';
+    }
+    if (!device_attr_parse(cls, sn, attr, s)) {
+        return -1;
+    }
+    if ((cls == EV3_ATTR_TACHO) && (attr == EV3_ATTR_COMMAND)) {
+        diff_drive_command(sn);
+    }
+    return len;
+}
+
+/**
+ * @brief List the devices of a class directory
+ *
+ * @param path the directory
+ * @param buf where to put the names
+ * @param sz the size of buf
+ * @return int the size of the list, < 0 if error
+ */
+static int udpd_listdir(const char *path, char *buf, size_t sz) {
+    int cls;
+    const char *prefix;
+    if (strcmp(path, SENSOR_DIR) == 0) {
+        cls = EV3_ATTR_SENSOR;
+        prefix = "sensor";
+    } else if (strcmp(path, TACHO_DIR) == 0) {
+        cls = EV3_ATTR_TACHO;
+        prefix = "motor";
+    } else {
+        return -1;
+    }
+    size_t len = 0;
+    for (int sn = 0; sn < devices_count(cls); sn++) {
+        int n = snprintf(buf + len, sz - len, "%s%d", prefix, sn);
+        if ((n < 0) || (len + n + 1 > sz)) {
+            break;
+        }
+        len += n + 1; // With the '\0'
+    }
+    return len;
+}
+
+/**
+ * @brief Answer a request
+ *
+ * @param rq the request
+ * @param len the size of the request
+ * @param reply where to build the reply
+ * @return size_t the size of the reply
+ */
+static size_t udpd_handle(const char *rq, size_t len, char *reply) {
+    EV3_UDP_HEADER h;
+    memcpy(&h, rq, sizeof(h));
+    const char *data = rq + sizeof(h);
+    const char *end = rq + len;
+    char *out = reply + sizeof(h);
+    size_t room = EV3_UDP_SIZE - sizeof(h);
+    int result = -1;
+    size_t out_len = 0;
+
+    const char *path = data;
+    const char *path_end = memchr(data, '\0', end - data);
+    switch (h.command) {
+    case EV3_UDP_READ:
+    case EV3_UDP_LISTDIR:
+        if (!path_end) {
+            break;
+        }
+        if (h.size < room) {
+            room = h.size;
+        }
+        result = (h.command == EV3_UDP_READ) ? udpd_read(path, out, room)
+                                              : udpd_listdir(path, out, room);
+        out_len = (result > 0) ? result : 0;
+        break;
+    case EV3_UDP_WRITE:
+        if (path_end && (path_end + 1 + h.size <= end)) {
+            result = udpd_write(path, path_end + 1, h.size);
+        }
+        break;
+    case EV3_UDP_KEYS:
+        if (room >= 1) {
+            out[0] = keys;
+            result = out_len = 1;
+        }
+        break;
+    case EV3_UDP_POWEROFF:
+        powered_off = true;
+        result = 0;
+        break;
+    case EV3_UDP_MULTI_WRITE: {
+        if (data >= end) {
+            break;
+        }
+        uint8_t count = data[0];
+        const uint8_t *sn = (const uint8_t *)data + 1;
+        uint16_t pos;
+        path = data + 1 + count + sizeof(pos);
+        if (path >= end) {
+            break;
+        }
+        memcpy(&pos, data + 1 + count, sizeof(pos));
+        path_end = memchr(path, '\0', end - path);
+        if (!path_end || (path_end + 1 + h.size > end) ||
+            (pos > path_end - path)) {
+            break;
+        }
+        result = 0;
+        for (int i = 0; i < count; i++) {
+            char full[128];
+            snprintf(full, sizeof(full), "%.*s%u%s", pos, path, sn[i],
+                     path + pos);
+            int n = udpd_write(full, path_end + 1, h.size);
+            if (n < 0) {
+                result = -1;
+                break;
+            }
+            result += n;
+        }
+        break;
+    }
+    }
+
+    if (result < 0) {
+        refused++;
+    }
+    h.status = (result < 0) ? 1 : 0;
+    h.size = (result < 0) ? 0 : result;
+    memcpy(reply, &h, sizeof(h));
+    return sizeof(h) + out_len;
+}
+
+/**
+ * @brief Send the replies whose delay is over
+ *
+ * @param fd the socket
+ * @param now the current time
+ * @return long long when the next one is due (LLONG_MAX if none)
+ */
+static long long udpd_flush(int fd, long long now) {
+    long long next = LLONG_MAX;
+    for (int i = 0; i < pending_count;) {
+        UDPD_REPLY *r = &pending[i];
+        if (r->due_us > now) {
+            if (r->due_us < next) {
+                next = r->due_us;
+            }
+            i++;
+            continue;
+        }
+        sendto(fd, r->msg, r->len, 0, (struct sockaddr *)&r->to,
+               sizeof(r->to));
+        instr_hist_add(&total[r->command], clock_now_us() - r->rx_us);
+        pending[i] = pending[--pending_count]; // Order does not matter
+    }
+    return next;
+}
+
+/**
+ * @brief Tell the clients where the brick is
+ *
+ * @param fd the socket
+ * @param to where to send it, the broadcast address by default
+ */
+static void udpd_announce(int fd, const struct sockaddr_in *to) {
+    static const char name[] = "ev3dev";
+    char msg[sizeof(EV3_UDP_HEADER) + sizeof(name)];
+    EV3_UDP_HEADER h = {0, EV3_UDP_BRICK, 0, sizeof(name)};
+    memcpy(msg, &h, sizeof(h));
+    memcpy(msg + sizeof(h), name, sizeof(name));
+    sendto(fd, msg, sizeof(msg), 0, (struct sockaddr *)to, sizeof(*to));
+}
+
+/**
+ * @brief Print the time taken to answer, by command
+ */
+static void udpd_dump(void) {
+    printf("%-12s %8s %8s %8s %8s %8s\n", "us", "count", "p50", "p99", "max",
+           "+delay");
+    for (int c = 0; c < EV3_UDP_COMMAND_COUNT; c++) {
+        if (!service[c].count) {
+            continue;
+        }
+        printf("%-12s %8lu %8lld %8lld %8lld %8lld\n", command_name[c],
+               service[c].count, instr_hist_percentile(&service[c], 50),
+               instr_hist_percentile(&service[c], 99), service[c].max,
+               instr_hist_percentile(&total[c], 50));
+    }
+    printf("%lu refused, %lu dropped\n", refused, dropped);
+}
+
+int main(int argc, char **argv) {
+    int port = EV3_UDP_PORT;
+    const char *announce_addr = NULL;
+    int latency_ms = 0;
+    int jitter_ms = 0;
+    bool verbose = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:b:k:l:j:v")) != -1) {
+        switch (opt) {
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 'b':
+            announce_addr = optarg;
+            break;
+        case 'k':
+            keys = strtol(optarg, NULL, 0);
+            break;
+        case 'l':
+            latency_ms = atoi(optarg);
+            break;
+        case 'j':
+            jitter_ms = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr,
+                    "Usage: %s [-p port] [-b address] [-k keys] [-l latency] "
+                    "[-j jitter] [-v]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    int on = 1;
+    struct sockaddr_in announce = {0};
+    announce.sin_family = AF_INET;
+    announce.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+    announce.sin_port = htons(EV3_UDP_ANNOUNCE_PORT);
+    if ((fd < 0) || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on)) ||
+        (announce_addr &&
+         (inet_pton(AF_INET, announce_addr, &announce.sin_addr) != 1))) {
+        perror("ev3_udpd");
+        return 2;
+    }
+
+    long long now = clock_now_us();
+    arena_default(&arena);
+    devices_reset();
+    diff_drive_init(&arena, now);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    srand(now);
+    printf("Simulated brick on port %d, replies delayed by %d ms (+%d)\n",
+           port, latency_ms, jitter_ms);
+
+    long long next_step = now + UDPD_STEP_US;
+    long long print = now;
+    long long next_announce = now;
+    while (!quit && !(powered_off && (pending_count == 0))) {
+        now = clock_now_us();
+        if (now >= next_announce) {
+            udpd_announce(fd, &announce);
+            next_announce = now + EV3_UDP_ANNOUNCE_MS * 1000LL;
+        }
+        long long next = udpd_flush(fd, now);
+        if (next_step < next) {
+            next = next_step;
+        }
+        if (next_announce < next) {
+            next = next_announce;
+        }
+        struct pollfd p = {fd, POLLIN, 0};
+        long long wait = next - now;
+        struct timespec ts = {wait / 1000000, (wait % 1000000) * 1000};
+        if (wait < 0) {
+            ts.tv_sec = ts.tv_nsec = 0;
+        }
+        if (ppoll(&p, 1, &ts, NULL) > 0) {
+            char rq[EV3_UDP_SIZE];
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            ssize_t n = recvfrom(fd, rq, sizeof(rq), 0,
+                                 (struct sockaddr *)&from, &from_len);
+            long long rx = clock_now_us();
+            if (n < (ssize_t)sizeof(EV3_UDP_HEADER)) {
+                refused++;
+                continue;
+            }
+            if (pending_count == UDPD_PENDING) {
+                dropped++;
+                continue;
+            }
+            UDPD_REPLY *r = &pending[pending_count++];
+            r->len = udpd_handle(rq, n, r->msg);
+            r->command = ((EV3_UDP_HEADER *)r->msg)->command;
+            if (r->command >= EV3_UDP_COMMAND_COUNT) {
+                r->command = EV3_UDP_BRICK; // Counted as "other"
+            }
+            r->to = from;
+            r->rx_us = rx;
+            r->due_us = clock_now_us();
+            instr_hist_add(&service[r->command], r->due_us - rx);
+            r->due_us += (long long)latency_ms * 1000;
+            if (jitter_ms > 0) {
+                r->due_us += rand() % (jitter_ms * 1000);
+            }
+        }
+        now = clock_now_us();
+        while (next_step <= now) {
+            diff_drive_step(next_step);
+            next_step += UDPD_STEP_US;
+        }
+        if (verbose && (now >= print)) {
+            POSE pose;
+            diff_drive_get_pose(&pose);
+            printf("x %6.0f y %6.0f heading %6.1f\n", pose.x, pose.y,
+                   pose.heading);
+            print = now + UDPD_PRINT_US;
+        }
+    }
+    udpd_dump();
+    close(fd);
+    return 0;
+}
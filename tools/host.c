@@ -0,0 +1,180 @@
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/clock.h"
+#include "../src/drive.h"
+#include "../src/ev3_attr.h"
+#include "../src/instr.h"
+#include "../src/sensor_hub.h"
+#include "host.h"
+
+static const HOST_MODEL *host_model;
+static long long host_now;
+static jmp_buf host_jmp;
+static bool host_running = false;
+
+void host_init(const HOST_MODEL *model, long long start_us) {
+    devices_reset();
+    host_model = model;
+    host_now = start_us;
+}
+
+int host_run(int (*entry)(void)) {
+    int status = setjmp(host_jmp);
+    if (status) {
+        host_running = false;
+        return status - 1; // See host_exit
+    }
+    host_running = true;
+    status = entry();
+    host_running = false;
+    return status;
+}
+
+void host_exit(int status) {
+    if (!host_running) {
+        exit(status);
+    }
+    longjmp(host_jmp, status + 1); // setjmp must not return 0
+}
+
+long long host_now_us(void) { return host_now; }
+
+// Clock ////////////////////////////////////////
+
+long long clock_now_us(void) { return host_now; }
+
+long long clock_now_ms(void) { return host_now / 1000; }
+
+void clock_sleep_ms(int msec) {
+    clock_sleep_until_us(host_now + (long long)msec * 1000);
+}
+
+bool clock_is_virtual(void) { return true; }
+
+void clock_sleep_until_us(long long deadline_us) {
+    while (host_now < deadline_us) {
+        host_now += HOST_STEP_US;
+        if (host_now > deadline_us) {
+            host_now = deadline_us;
+        }
+        if (host_model && host_model->step) {
+            host_model->step(host_now);
+        }
+        sensor_hub_poll(host_now);
+        drive_deadman_check(host_now);
+    }
+}
+
+// Attributes ///////////////////////////////////
+
+const char *ev3_attr_root(void) { return ""; }
+
+size_t ev3_attr_read_binary(int cls, uint8_t sn, int attr, void *buf,
+                            size_t sz) {
+    instr_count_read();
+    if ((cls == EV3_ATTR_SENSOR) && (attr == EV3_ATTR_BIN_DATA)) {
+        if (sn >= DEVICE_SENSOR_COUNT) {
+            return 0;
+        }
+        size_t n = device_sensor[sn].values.count * sizeof(float);
+        if (n > sz) {
+            n = sz;
+        }
+        memcpy(buf, device_sensor[sn].values.value, n);
+        return n;
+    }
+    char s[64];
+    if ((sz == 0) || !device_attr_format(cls, sn, attr, s, sizeof(s))) {
+        return 0;
+    }
+    size_t n = snprintf(buf, sz, "%s\n", s); // Like sysfs, with a newline
+    return (n < sz) ? n : sz - 1;
+}
+
+size_t ev3_attr_read(int cls, uint8_t sn, int attr, char *buf, size_t sz) {
+    if (sz == 0) {
+        return 0;
+    }
+    size_t n = ev3_attr_read_binary(cls, sn, attr, buf, sz - 1);
+    buf[n] = '\0';
+    while ((n > 0) && (buf[n - 1] == '\n')) {
+        buf[--n] = '\0';
+    }
+    return n;
+}
+
+size_t ev3_attr_read_int(int cls, uint8_t sn, int attr, int *value) {
+    char s[32];
+    char *end;
+    if (!ev3_attr_read(cls, sn, attr, s, sizeof(s))) {
+        return 0;
+    }
+    long val = strtol(s, &end, 10);
+    if (end == s) {
+        return 0;
+    }
+    *value = (int)val;
+    return end - s;
+}
+
+size_t ev3_attr_read_float(int cls, uint8_t sn, int attr, float *value) {
+    char s[32];
+    char *end;
+    if (!ev3_attr_read(cls, sn, attr, s, sizeof(s))) {
+        return 0;
+    }
+    float val = strtof(s, &end);
+    if (end == s) {
+        return 0;
+    }
+    *value = val;
+    return end - s;
+}
+
+size_t ev3_attr_write(int cls, uint8_t sn, int attr, const char *value) {
+    instr_count_write();
+    if (!device_attr_parse(cls, sn, attr, value)) {
+        return 0;
+    }
+    if ((attr == EV3_ATTR_COMMAND) && host_model && host_model->command) {
+        host_model->command(sn);
+    }
+    return strlen(value);
+}
+
+size_t ev3_attr_write_int(int cls, uint8_t sn, int attr, int value) {
+    char s[16];
+    snprintf(s, sizeof(s), "%d", value);
+    return ev3_attr_write(cls, sn, attr, s);
+}
+
+bool ev3_attr_search(int cls, int attr, const char *value, uint8_t *sn,
+                     uint8_t from) {
+    char s[64];
+    for (int i = from; i < devices_count(cls); i++) {
+        if (!value || (device_attr_format(cls, i, attr, s, sizeof(s)) &&
+                       (strcmp(s, value) == 0))) {
+            *sn = i;
+            return true;
+        }
+    }
+    *sn = DESC_LIMIT;
+    return false;
+}
+
+// The devices never disappear
+void ev3_attr_invalidate(int cls, uint8_t sn) {
+    (void)cls;
+    (void)sn;
+}
+
+uint32_t ev3_attr_generation(int cls, uint8_t sn) {
+    (void)cls;
+    (void)sn;
+    return 0;
+}
+
+void ev3_attr_close_all(void) {}
@@ -0,0 +1,68 @@
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "devices.h"
+
+/*
+ * Run the program of the robot on the computer, in simulated time.
+ *
+ * This file replaces src/ev3_attr.c and src/clock.c. The program accesses the
+ * devices of tools/devices.h directly, a model (replay of a log, simulation of
+ * the arena) updates them as the time advances.
+ *
+ * The clock only advances when the program sleeps, by steps of HOST_STEP_US.
+ * At each step the model is updated, then the sensor hub and the deadman are
+ * polled, so their threads are not started. A run is deterministic: with the
+ * same model, the program does exactly the same thing every time.
+ *
+ * main.c is built with -Dmain=robot_main, -DCONTROL_REALTIME=false and
+ * -DPLAY_SOUND=false.
+ */
+
+#define HOST_STEP_US 1000
+
+/**
+ * @brief What makes the devices move
+ */
+typedef struct {
+    // The time advanced to now_us, update the devices
+    void (*step)(long long now_us);
+    // A command was written to a tacho (can be NULL)
+    void (*command)(uint8_t sn);
+} HOST_MODEL;
+
+/**
+ * @brief Reset the devices (devices_reset) and the clock
+ *
+ * @param model the model, it must stay valid during the run
+ * @param start_us the time of the clock when the program starts
+ */
+void host_init(const HOST_MODEL *model, long long start_us);
+
+/**
+ * @brief Run the program until it returns or host_exit is called
+ * The program can only be run once per process, its globals are not reset.
+ *
+ * @param entry the main function of the program
+ * @return int what the program returned, or the status given to host_exit
+ */
+int host_run(int (*entry)(void));
+
+/**
+ * @brief Stop the run, from the model (end of the log, end of the match, ...)
+ *
+ * @param status the value host_run will return
+ */
+void host_exit(int status);
+
+/**
+ * @brief Get the time of the simulated clock
+ *
+ * @return long long the time in microseconds
+ */
+long long host_now_us(void);
+
+#endif /* HOST_H */
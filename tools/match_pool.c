@@ -0,0 +1,144 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../src/params.h"
+#include "match_pool.h"
+
+/**
+ * @brief A match being played
+ */
+typedef struct {
+    pid_t pid; // 0 if the slot is free
+    int fd;    // Read end of its stdout
+    int task;
+} POOL_SLOT;
+
+int match_pool_cores(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (int)n : 1;
+}
+
+/**
+ * @brief Start a match
+ *
+ * @param slot where to store what it needs to be waited for
+ * @param tasks the matches
+ * @param task the match to start
+ * @return int 0 if it started
+ */
+static int pool_start(POOL_SLOT *slot, const MATCH_TASK *tasks, int task) {
+    const MATCH_TASK *t = &tasks[task];
+    int fd[2];
+    if (pipe(fd)) {
+        return -1;
+    }
+    char seed[16];
+    snprintf(seed, sizeof(seed), "%u", t->seed);
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fd[0]);
+        close(fd[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close(fd[0]);
+        dup2(fd[1], STDOUT_FILENO);
+        close(fd[1]);
+        if (t->params) {
+            setenv(PARAMS_ENV, t->params, 1);
+        } else {
+            unsetenv(PARAMS_ENV);
+        }
+        if (t->seconds) {
+            execl(t->build, t->build, "-q", "-r", seed, "-t", t->seconds,
+                  (char *)NULL);
+        } else {
+            execl(t->build, t->build, "-q", "-r", seed, (char *)NULL);
+        }
+        perror(t->build);
+        _exit(2);
+    }
+    close(fd[1]);
+    slot->pid = pid;
+    slot->fd = fd[0];
+    slot->task = task;
+    return 0;
+}
+
+/**
+ * @brief Read the result of a match that ended
+ * Its output is one short line, already in the pipe.
+ *
+ * @param slot the match
+ * @param r where to store its result
+ */
+static void pool_collect(POOL_SLOT *slot, MATCH_RESULT *r) {
+    char s[128];
+    size_t len = 0;
+    ssize_t n;
+    while ((len < sizeof(s) - 1) &&
+           ((n = read(slot->fd, s + len, sizeof(s) - 1 - len)) != 0)) {
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        len += n;
+    }
+    s[len] = '\0';
+    close(slot->fd);
+    int in_base;
+    r->done = sscanf(s, "%d %lld %lld %lld", &in_base, &r->caught_us,
+                     &r->base_us, &r->end_us) == 4;
+    r->in_base = r->done && in_base;
+    slot->pid = 0;
+}
+
+int match_pool_run(int jobs, const MATCH_TASK *tasks, int count,
+                   MATCH_RESULT *results) {
+    POOL_SLOT *slots = calloc(jobs, sizeof(POOL_SLOT));
+    if (!slots) {
+        return -1;
+    }
+    memset(results, 0, count * sizeof(MATCH_RESULT));
+    int next = 0;
+    int running = 0;
+    int status = 0;
+    while (((next < count) && !status) || running) {
+        for (int i = 0; (i < jobs) && (next < count) && !status; i++) {
+            if (!slots[i].pid) {
+                if (pool_start(&slots[i], tasks, next)) {
+                    status = -1; // Wait for the running ones, then stop
+                    break;
+                }
+                next++;
+                running++;
+            }
+        }
+        if (!running) {
+            break;
+        }
+        pid_t pid = wait(NULL);
+        if (pid < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            status = -1;
+            break;
+        }
+        for (int i = 0; i < jobs; i++) {
+            if (slots[i].pid == pid) {
+                pool_collect(&slots[i], &results[slots[i].task]);
+                running--;
+                break;
+            }
+        }
+    }
+    free(slots);
+    return status;
+}
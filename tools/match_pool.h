@@ -0,0 +1,50 @@
+#ifndef MATCH_POOL_H
+#define MATCH_POOL_H
+
+#include <stdbool.h>
+
+/*
+ * Play random matches of arena_sim builds on all the cores. A match is a
+ * process running a build with -q -r seed, the pool starts the next match as
+ * soon as one ends, so a core is never idle while matches remain.
+ */
+
+/**
+ * @brief A match to play
+ */
+typedef struct {
+    const char *build;   // The arena_sim binary
+    unsigned seed;       // Of the random match
+    const char *seconds; // The length of the match (NULL for the default)
+    const char *params;  // File of parameters of the program (NULL for none)
+} MATCH_TASK;
+
+/**
+ * @brief Result of a match
+ */
+typedef struct {
+    bool done;         // The build printed a result
+    bool in_base;      // The flag is in the base at the end
+    long long caught_us;
+    long long base_us; // -1 if the flag was never in the base
+    long long end_us;
+} MATCH_RESULT;
+
+/**
+ * @brief Get the number of cores
+ */
+int match_pool_cores(void);
+
+/**
+ * @brief Play matches
+ *
+ * @param jobs the number of matches played at the same time
+ * @param tasks the matches
+ * @param count the number of matches
+ * @param results where to store their results, [count]
+ * @return int 0 if every match was played, even if some failed
+ */
+int match_pool_run(int jobs, const MATCH_TASK *tasks, int count,
+                   MATCH_RESULT *results);
+
+#endif /* MATCH_POOL_H */
@@ -0,0 +1,132 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "match_pool.h"
+
+/*
+ * Play many random matches of one or several builds of the program, on all
+ * the cores, and compare how often and how fast they bring the flag back.
+ *
+ * Each build is an arena_sim binary (tools/arena_sim.c linked with a version
+ * of main.c), the matches are played by tools/match_pool.c. Every build plays
+ * the same seeds, the same matches.
+ *
+ * Usage: monte_carlo [-n matches] [-j jobs] [-s seed] [-t seconds]
+ *                    [-p params.txt] [build ...] (default bin/arena_sim)
+ */
+
+#define MC_MATCHES 1000
+#define MC_DEFAULT_BUILD "bin/arena_sim"
+
+static char **builds;
+static int build_count;
+static int matches = MC_MATCHES;
+static MATCH_RESULT *results; // [task], task = match * build_count + build
+
+static int compare_ll(const void *a, const void *b) {
+    long long x = *(const long long *)a;
+    long long y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Print what a build did over all the matches
+ *
+ * @param build the build
+ */
+static void mc_print(int build) {
+    long long *times = malloc(matches * sizeof(long long));
+    int done = 0;
+    int caught = 0;
+    int success = 0;
+    long long sum = 0;
+    for (int m = 0; m < matches; m++) {
+        const MATCH_RESULT *r = &results[m * build_count + build];
+        done += r->done;
+        caught += r->done && (r->caught_us >= 0);
+        if (r->in_base && (r->base_us >= 0)) {
+            times[success++] = r->base_us;
+            sum += r->base_us;
+        }
+    }
+    qsort(times, success, sizeof(long long), compare_ll);
+    printf("%s\n", builds[build]);
+    printf("  %d matches, %d failed to run, flag caught in %d\n", matches,
+           matches - done, caught);
+    printf("  success %d (%.1f %%)\n", success,
+           matches ? 100.0 * success / matches : 0);
+    if (success) {
+        printf("  time to the base (s): mean %.2f p10 %.2f p50 %.2f "
+               "p90 %.2f max %.2f\n",
+               sum / 1e6 / success, times[success / 10] / 1e6,
+               times[success / 2] / 1e6, times[success * 9 / 10] / 1e6,
+               times[success - 1] / 1e6);
+    }
+    free(times);
+}
+
+int main(int argc, char **argv) {
+    int jobs = match_pool_cores();
+    unsigned seed = 1;
+    const char *seconds = NULL;
+    const char *params = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:j:s:t:p:")) != -1) {
+        switch (opt) {
+        case 'n':
+            matches = atoi(optarg);
+            break;
+        case 'j':
+            jobs = atoi(optarg);
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            seconds = optarg;
+            break;
+        case 'p':
+            params = optarg;
+            break;
+        default:
+            fprintf(stderr,
+                    "Usage: %s [-n matches] [-j jobs] [-s seed] "
+                    "[-t seconds] [-p params.txt] [build ...]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    static char *default_build[] = {MC_DEFAULT_BUILD};
+    builds = (optind < argc) ? argv + optind : default_build;
+    build_count = (optind < argc) ? argc - optind : 1;
+    if ((matches <= 0) || (jobs <= 0)) {
+        fprintf(stderr, "%s: nothing to do\n", argv[0]);
+        return 2;
+    }
+
+    int count = matches * build_count;
+    MATCH_TASK *tasks = calloc(count, sizeof(MATCH_TASK));
+    results = calloc(count, sizeof(MATCH_RESULT));
+    if (!tasks || !results) {
+        perror("monte_carlo");
+        return 2;
+    }
+    for (int i = 0; i < count; i++) {
+        tasks[i] = (MATCH_TASK){builds[i % build_count],
+                                seed + i / build_count, seconds, params};
+    }
+    if (match_pool_run(jobs, tasks, count, results)) {
+        perror("monte_carlo");
+        return 2;
+    }
+
+    printf("%d matches from seed %u, %d jobs\n", matches, seed, jobs);
+    for (int b = 0; b < build_count; b++) {
+        mc_print(b);
+    }
+    free(tasks);
+    free(results);
+    return 0;
+}
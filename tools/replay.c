@@ -0,0 +1,289 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/clock.h"
+#include "../src/sensor_hub.h"
+#include "../src/tick.h"
+#include "host.h"
+#include "telemetry_read.h"
+
+/*
+ * Run the program of the robot again on the computer, from a telemetry log.
+ * The sensors return what was recorded, at the time it was recorded, and the
+ * commands of every tick are compared with the ones of the log. The program
+ * runs in simulated time, so a whole match is replayed in a fraction of a
+ * second.
+ *
+ * The log holds the last sample of each sensor at the end of each tick, as
+ * the program got it from the sensor hub, and its time, with the last state
+ * read from each tacho. Once the loop of the
+ * program starts (telemetry_open follows tick_init), the clock of the replay
+ * is lined up with the one of the log, and the samples are published in the
+ * hub again at their time: before the tick if they came before it started,
+ * else before the next one. The hub no longer reads the devices then, so the
+ * gyro is not corrected twice. A tick that started late in the log is made
+ * late in the replay too. What happens before the loop (the calibration of
+ * the gyro) only runs on the first record.
+ *
+ * The samples that came and were replaced between two ticks are not in the
+ * log, nor the ones read and replaced during the work of a tick, so they can
+ * still make the replay differ.
+ *
+ * Usage: replay [-v] telemetry.bin > program.txt
+ * Return 0 if the commands are the same, 1 if they differ, 2 if error.
+ */
+
+#define REPLAY_END 100 // Status of host_run when the log is over
+#define REPLAY_MARGIN_US 1000000 // Time run after the last record
+
+int robot_main(void); // main.c
+
+static TELEMETRY_RECORD *records;
+static size_t record_count;
+static size_t current;  // Record of the next tick to publish the samples of
+static size_t expected; // Record the next tick is compared with
+static bool verbose = false;
+static bool aligned = false; // Once the loop of the program started
+static long long offset;     // Time of the replay - time of the log
+static long long period;     // Between two ticks that were not late
+static long long published[HUB_SENSOR_COUNT]; // Time in the log of the last
+
+static struct {
+    unsigned long ticks;    // Ticks of the replay
+    unsigned long compared; // Ticks found in the log
+    unsigned long diverged; // Ticks with a different command
+    unsigned long late;     // Ticks that started late in the log
+    long first;             // First tick that differs (-1 if none)
+} result = {0, 0, 0, 0, -1};
+
+/**
+ * @brief Get the values of a sensor of the hub in a record
+ *
+ * @param r the record
+ * @param id the sensor (HUB_*)
+ * @param values where to store them
+ */
+static void replay_values(const TELEMETRY_RECORD *r, int id,
+                          SENSOR_VALUES *values) {
+    memset(values, 0, sizeof(*values));
+    values->count = 1;
+    switch (id) {
+    case HUB_SONAR:
+        values->value[0] = r->sonar_raw;
+        break;
+    case HUB_GYRO:
+        values->count = 2; // GYRO-G&A
+        values->value[0] = r->gyro;
+        values->value[1] = r->gyro_rate;
+        break;
+    case HUB_COLOR:
+        values->value[0] = r->color;
+        break;
+    case HUB_WHEEL_LEFT:
+        values->count = 2;
+        values->value[0] = r->speed_left;
+        values->value[1] = r->position_left;
+        break;
+    case HUB_WHEEL_RIGHT:
+        values->count = 2;
+        values->value[0] = r->speed_right;
+        values->value[1] = r->position_right;
+        break;
+    }
+}
+
+/**
+ * @brief Publish the samples the program had at the start of a tick
+ * A sample that came during the work of the tick is taken from the record
+ * before, it is published with the next tick.
+ *
+ * @param i the record of the tick
+ */
+static void replay_publish(size_t i) {
+    const TELEMETRY_RECORD *r = &records[i];
+    for (int id = 0; id < HUB_SENSOR_COUNT; id++) {
+        const TELEMETRY_RECORD *from = r;
+        if ((r->sample_us[id] > r->wake_us) && (i > 0)) {
+            from = &records[i - 1];
+        }
+        if (from->sample_us[id] == TELEMETRY_NO_SAMPLE) {
+            continue;
+        }
+        long long time_us = from->tick_us + from->sample_us[id];
+        if (time_us == published[id]) {
+            continue; // Already there
+        }
+        SENSOR_VALUES values;
+        replay_values(from, id, &values);
+        sensor_hub_publish(id, &values, time_us + offset);
+        published[id] = time_us;
+    }
+    // What the reads of the state during the tick got, if there were some
+    device_tacho[DEVICE_WHEEL_LEFT].state = r->state_left;
+    device_tacho[DEVICE_WHEEL_RIGHT].state = r->state_right;
+    device_tacho[DEVICE_CLAMP].state = r->state_clamp;
+}
+
+/**
+ * @brief Set the sensors to the record of the time
+ * Before the loop of the program, the devices have the first record.
+ *
+ * @param now_us the time of the simulated clock
+ */
+static void replay_step(long long now_us) {
+    if (!aligned) {
+        const TELEMETRY_RECORD *r = &records[0];
+        device_sensor[DEVICE_SONAR].values.value[0] = r->sonar_raw;
+        device_sensor[DEVICE_GYRO].values.value[0] = r->gyro;
+        device_sensor[DEVICE_GYRO].values.value[1] = r->gyro_rate;
+        device_sensor[DEVICE_COLOR].values.value[0] = r->color;
+        device_tacho[DEVICE_WHEEL_LEFT].speed = r->speed_left;
+        device_tacho[DEVICE_WHEEL_LEFT].position = r->position_left;
+        device_tacho[DEVICE_WHEEL_RIGHT].speed = r->speed_right;
+        device_tacho[DEVICE_WHEEL_RIGHT].position = r->position_right;
+        return;
+    }
+    while ((current < record_count) &&
+           (records[current].tick_us + offset <= now_us)) {
+        replay_publish(current++);
+    }
+    if (now_us >
+        records[record_count - 1].tick_us + offset + REPLAY_MARGIN_US) {
+        host_exit(REPLAY_END);
+    }
+}
+
+static const HOST_MODEL replay_model = {replay_step, NULL};
+
+/**
+ * @brief Print a tick of the replay and the same tick of the log
+ *
+ * @param got the tick of the replay
+ * @param want the tick of the log
+ */
+static void replay_print(const TELEMETRY_RECORD *got,
+                         const TELEMETRY_RECORD *want) {
+    fprintf(stderr,
+            "tick %u: action %u/%u, wheels %d,%d/%d,%d, clamp %d,%u/%d,%u\n",
+            got->tick, got->action, want->action, got->cmd_left,
+            got->cmd_right, want->cmd_left, want->cmd_right, got->cmd_clamp,
+            got->clamp, want->cmd_clamp, want->clamp);
+}
+
+// The log of the replay is not written, telemetry.c is replaced by this
+
+// Called by the program just after tick_init: its first tick starts now
+int telemetry_open(const char *path, int blocks) {
+    (void)path;
+    (void)blocks;
+    offset = tick_time_us() - records[0].tick_us;
+    aligned = true;
+    replay_publish(current++);
+    return 0;
+}
+
+/**
+ * @brief Make the next tick late if it was in the log
+ * The time passes now, at the end of the work of this tick, so the scheduler
+ * of the program starts the next one at the same time as in the log.
+ *
+ * @param i the record of this tick
+ */
+static void replay_late(size_t i) {
+    if ((i + 1 < record_count) &&
+        (records[i + 1].tick_us - records[i].tick_us >
+         period * (records[i + 1].tick - records[i].tick))) {
+        result.late++;
+        clock_sleep_until_us(records[i + 1].tick_us + offset);
+    }
+}
+
+void telemetry_log(const TELEMETRY_RECORD *record) {
+    result.ticks++;
+    while ((expected < record_count) &&
+           (records[expected].tick < record->tick)) {
+        expected++;
+    }
+    if ((expected >= record_count) ||
+        (records[expected].tick != record->tick)) {
+        return; // Not in the log (corrupt block)
+    }
+    const TELEMETRY_RECORD *r = &records[expected];
+    result.compared++;
+    if ((record->action != r->action) || (record->cmd_left != r->cmd_left) ||
+        (record->cmd_right != r->cmd_right) ||
+        (record->cmd_clamp != r->cmd_clamp) || (record->clamp != r->clamp)) {
+        if (verbose || (result.first < 0)) {
+            replay_print(record, r);
+        }
+        if (result.first < 0) {
+            result.first = record->tick;
+        }
+        result.diverged++;
+    }
+    replay_late(expected);
+}
+
+void telemetry_close(void) {}
+
+int main(int argc, char **argv) {
+    if ((argc == 3) && (strcmp(argv[1], "-v") == 0)) {
+        verbose = true;
+        argv++;
+        argc--;
+    }
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s [-v] telemetry.bin\n", argv[0]);
+        return 2;
+    }
+    TELEMETRY_READ_STATS stats;
+    if (telemetry_read(argv[1], &records, &record_count, &stats)) {
+        return 2;
+    }
+    if (record_count < 2) {
+        fprintf(stderr, "%s: not enough records\n", argv[1]);
+        return 2;
+    }
+    if (records[0].tick != 0) {
+        fprintf(stderr, "%s: the start of the run was overwritten\n",
+                argv[1]);
+        return 2;
+    }
+
+    period = records[1].tick_us - records[0].tick_us;
+    for (size_t i = 1; i < record_count; i++) { // The ticks that were on time
+        long long gap = (records[i].tick_us - records[i - 1].tick_us) /
+                        (records[i].tick - records[i - 1].tick);
+        if ((gap > 0) && (gap < period)) {
+            period = gap;
+        }
+    }
+    for (int id = 0; id < HUB_SENSOR_COUNT; id++) {
+        published[id] = -1;
+    }
+
+    long long start = records[0].tick_us; // The init takes its own time
+    host_init(&replay_model, start);
+    device_sensor[DEVICE_GYRO].values.count = 2; // GYRO-G&A
+    replay_step(start);
+
+    clock_t cpu = clock();
+    int status = host_run(robot_main);
+    cpu = clock() - cpu;
+
+    fprintf(stderr, "%s after %.1f s (%.2f s of CPU)\n",
+            (status == REPLAY_END) ? "End of the log" : "Program returned",
+            (host_now_us() - start) / 1e6, (double)cpu / CLOCKS_PER_SEC);
+    fprintf(stderr, "%lu ticks replayed, %zu in the log, %lu compared, "
+                    "%lu differ, %lu started late\n",
+            result.ticks, record_count, result.compared, result.diverged,
+            result.late);
+    if (result.first >= 0) {
+        fprintf(stderr, "First difference at tick %ld\n", result.first);
+    }
+    free(records);
+    return result.diverged ? 1 : 0;
+}
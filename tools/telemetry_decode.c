@@ -0,0 +1,45 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "telemetry_read.h"
+
+/*
+ * Print a telemetry log of the robot as CSV, one line per tick.
+ * Usage: telemetry_decode telemetry.bin > run.csv
+ */
+
+static const char *clamp_name[] = {"stopped", "opening", "closing", "holding"};
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s telemetry.bin\n", argv[0]);
+        return 1;
+    }
+    TELEMETRY_RECORD *records;
+    size_t count;
+    TELEMETRY_READ_STATS stats;
+    if (telemetry_read(argv[1], &records, &count, &stats)) {
+        return 2;
+    }
+    fprintf(stderr, "%d blocks, %d valid, %d corrupt, %zu ticks\n",
+            stats.blocks, stats.valid, stats.corrupt, count);
+
+    printf("tick,time_ms,action,sonar_raw,sonar,gyro,gyro_rate,cmd_left,"
+           "cmd_right,speed_left,speed_right,position_left,position_right,"
+           "cmd_clamp,clamp,color,wake_ms,state_left,state_right,state_clamp\n");
+    long long start = count ? records[0].time_us : 0;
+    for (size_t i = 0; i < count; i++) {
+        TELEMETRY_RECORD *r = &records[i];
+        printf("%u,%.3f,%u,%.0f,%.1f,%.0f,%.0f,%d,%d,%d,%d,%d,%d,%d,%s,%u,"
+               "%.3f,%u,%u,%u\n",
+               r->tick, (r->time_us - start) / 1000.0, r->action,
+               r->sonar_raw, r->sonar, r->gyro, r->gyro_rate, r->cmd_left,
+               r->cmd_right, r->speed_left, r->speed_right, r->position_left,
+               r->position_right, r->cmd_clamp,
+               (r->clamp < 4) ? clamp_name[r->clamp] : "?", r->color,
+               r->wake_us / 1000.0, r->state_left, r->state_right,
+               r->state_clamp);
+    }
+    free(records);
+    return 0;
+}
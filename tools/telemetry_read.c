@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/crc32.h"
+#include "telemetry_read.h"
+
+/**
+ * @brief Compare two blocks by their number, for qsort
+ */
+static int block_cmp(const void *a, const void *b) {
+    uint32_t seq_a = (*(const TELEMETRY_BLOCK *const *)a)->header.seq;
+    uint32_t seq_b = (*(const TELEMETRY_BLOCK *const *)b)->header.seq;
+    return (seq_a > seq_b) - (seq_a < seq_b);
+}
+
+int telemetry_read(const char *path, TELEMETRY_RECORD **records, size_t *count,
+                   TELEMETRY_READ_STATS *stats) {
+    TELEMETRY_READ_STATS st = {0};
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    st.blocks = size / sizeof(TELEMETRY_BLOCK);
+    TELEMETRY_BLOCK *blocks = malloc(st.blocks * sizeof(TELEMETRY_BLOCK) + 1);
+    TELEMETRY_BLOCK **valid = malloc(st.blocks * sizeof(*valid) + 1);
+    if (!blocks || !valid ||
+        (fread(blocks, sizeof(TELEMETRY_BLOCK), st.blocks, f) !=
+         (size_t)st.blocks)) {
+        fprintf(stderr, "%s: could not read the file\n", path);
+        fclose(f);
+        free(blocks);
+        free(valid);
+        return 1;
+    }
+    fclose(f);
+
+    size_t total = 0;
+    for (int i = 0; i < st.blocks; i++) {
+        TELEMETRY_BLOCK_HEADER *h = &blocks[i].header;
+        if ((h->magic != TELEMETRY_MAGIC) ||
+            (h->version != TELEMETRY_VERSION) ||
+            (h->record_size != sizeof(TELEMETRY_RECORD)) ||
+            (h->count > TELEMETRY_BLOCK_RECORDS)) {
+            continue; // Never written, or from another version
+        }
+        if (crc32(0, (const char *)blocks[i].record,
+                  h->count * sizeof(TELEMETRY_RECORD)) != h->crc) {
+            st.corrupt++;
+            continue;
+        }
+        valid[st.valid++] = &blocks[i];
+        total += h->count;
+    }
+    qsort(valid, st.valid, sizeof(*valid), block_cmp);
+
+    *records = malloc(total * sizeof(TELEMETRY_RECORD) + 1);
+    *count = 0;
+    for (int i = 0; i < st.valid; i++) {
+        memcpy(*records + *count, valid[i]->record,
+               valid[i]->header.count * sizeof(TELEMETRY_RECORD));
+        *count += valid[i]->header.count;
+    }
+    free(blocks);
+    free(valid);
+    if (stats) {
+        *stats = st;
+    }
+    return 0;
+}
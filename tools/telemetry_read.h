@@ -0,0 +1,29 @@
+#ifndef TELEMETRY_READ_H
+#define TELEMETRY_READ_H
+
+#include <stddef.h>
+
+#include "../src/telemetry.h"
+
+/**
+ * @brief What was found in a log
+ */
+typedef struct {
+    int blocks;  // Blocks of the file
+    int valid;   // Blocks with a good header and crc
+    int corrupt; // Blocks with a good header but a bad crc
+} TELEMETRY_READ_STATS;
+
+/**
+ * @brief Read all the records of a log, in the order they were written
+ *
+ * @param path the path of the log
+ * @param records where to store the records (to free)
+ * @param count where to store the number of records
+ * @param stats what was found in the file (can be NULL)
+ * @return int 0 if the file could be read
+ */
+int telemetry_read(const char *path, TELEMETRY_RECORD **records, size_t *count,
+                   TELEMETRY_READ_STATS *stats);
+
+#endif /* TELEMETRY_READ_H */
@@ -0,0 +1,353 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/params.h"
+#include "match_pool.h"
+
+/*
+ * Search the parameters of the mission (src/params.h) that bring the flag
+ * back the fastest in the simulated arena, and write them in a file the
+ * program reads at startup.
+ *
+ * The search is an evolution strategy with a step per parameter (a diagonal
+ * CMA-ES without the covariance between parameters): every generation draws
+ * candidates around the mean, plays each of them on the same random matches
+ * (tools/match_pool.c), and moves the mean and the steps toward the best
+ * ones. The cost of a candidate is its mean time to bring the flag to the
+ * base; below the success rate floor (or without any success) it is worse
+ * than any candidate above.
+ *
+ * Every generation plays other matches, so the costs of two generations do
+ * not compare. The mean of every generation is kept, and at the end they are
+ * all played again on the same holdout matches (-H, seeds not used by the
+ * search): the best of them there is written.
+ *
+ * Usage: tune [-g generations] [-l candidates] [-n matches] [-H holdout]
+ *             [-f floor] [-j jobs] [-s seed] [-b build] [-o params.txt]
+ */
+
+#define TUNE_GENERATIONS 20
+#define TUNE_CANDIDATES 8   // Per generation
+#define TUNE_MATCHES 20     // Per candidate
+#define TUNE_HOLDOUT 50     // Per mean, to choose the one written
+#define TUNE_FLOOR 0.8      // Success rate below which a candidate is refused
+#define TUNE_STEP 0.2       // First step, the range of a parameter is 1
+#define TUNE_STEP_MIN 0.01
+#define TUNE_LEARN 0.3      // How fast the steps follow the selected ones
+#define TUNE_MATCH_US 180e6 // Length of a match, the cost of a failure
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/**
+ * @brief A point of the search
+ */
+typedef struct {
+    double x[sizeof(PARAMS) / sizeof(int)]; // Parameters scaled to 0 - 1
+    double cost;
+    double success; // Rate
+    double mean_s;  // Mean time to the base of the successes
+} CANDIDATE;
+
+static int dims[sizeof(PARAMS) / sizeof(int)]; // Parameters searched
+static int dim_count;
+static unsigned rng;
+
+/**
+ * @brief Get a random number of the normal distribution
+ */
+static double normal(void) {
+    double u = 1 - rand_r(&rng) / ((double)RAND_MAX + 1);
+    double v = rand_r(&rng) / ((double)RAND_MAX + 1);
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+/**
+ * @brief Make the parameters of a point of the search
+ */
+static void to_params(const CANDIDATE *c, PARAMS *p) {
+    params_default(p);
+    for (int d = 0; d < dim_count; d++) {
+        const PARAM_DESC *desc = params_desc(dims[d]);
+        *params_value(p, dims[d]) =
+            (int)lround(desc->min + c->x[d] * (desc->max - desc->min));
+    }
+}
+
+/**
+ * @brief Make the point of the search of the parameters
+ */
+static void from_params(PARAMS *p, CANDIDATE *c) {
+    for (int d = 0; d < dim_count; d++) {
+        const PARAM_DESC *desc = params_desc(dims[d]);
+        c->x[d] = (double)(*params_value(p, dims[d]) - desc->min) /
+                  (desc->max - desc->min);
+    }
+}
+
+/**
+ * @brief Write the parameters of a candidate in a file
+ *
+ * @return int 0 if written
+ */
+static int write_candidate(const CANDIDATE *c, const char *path) {
+    PARAMS p;
+    to_params(c, &p);
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    params_write(&p, f);
+    return fclose(f);
+}
+
+/**
+ * @brief Play every candidate on the same matches, and compute their cost
+ *
+ * @param c the candidates
+ * @param count the number of candidates
+ * @param dir where to write their files
+ * @param build the arena_sim binary
+ * @param matches the number of matches per candidate
+ * @param seed the seed of the first match
+ * @param floor the success rate floor
+ * @param jobs the number of matches played at the same time
+ * @return int 0 if they were played
+ */
+static int evaluate(CANDIDATE *c, int count, const char *dir,
+                    const char *build, int matches, unsigned seed,
+                    double floor, int jobs) {
+    int total = count * matches;
+    MATCH_TASK *tasks = calloc(total, sizeof(MATCH_TASK));
+    MATCH_RESULT *results = calloc(total, sizeof(MATCH_RESULT));
+    char(*paths)[256] = calloc(count, sizeof(*paths));
+    int status = -1;
+    if (!tasks || !results || !paths) {
+        goto end;
+    }
+    for (int i = 0; i < count; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "%s/candidate%d.txt", dir, i);
+        if (write_candidate(&c[i], paths[i])) {
+            goto end;
+        }
+        for (int m = 0; m < matches; m++) {
+            tasks[i * matches + m] =
+                (MATCH_TASK){build, seed + m, NULL, paths[i]};
+        }
+    }
+    if (match_pool_run(jobs, tasks, total, results)) {
+        goto end;
+    }
+    for (int i = 0; i < count; i++) {
+        int success = 0;
+        double sum = 0;
+        for (int m = 0; m < matches; m++) {
+            const MATCH_RESULT *r = &results[i * matches + m];
+            if (r->in_base && (r->base_us >= 0)) {
+                success++;
+                sum += r->base_us;
+            }
+        }
+        c[i].success = (double)success / matches;
+        c[i].mean_s = success ? sum / success / 1e6 : 0;
+        c[i].cost = (success && (c[i].success >= floor))
+                        ? sum / success
+                        : TUNE_MATCH_US * (2 - c[i].success);
+    }
+    status = 0;
+end:
+    for (int i = 0; paths && (i < count); i++) {
+        if (paths[i][0]) {
+            unlink(paths[i]);
+        }
+    }
+    free(paths);
+    free(results);
+    free(tasks);
+    return status;
+}
+
+static int compare_cost(const void *a, const void *b) {
+    double x = ((const CANDIDATE *)a)->cost;
+    double y = ((const CANDIDATE *)b)->cost;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+    int generations = TUNE_GENERATIONS;
+    int lambda = TUNE_CANDIDATES;
+    int matches = TUNE_MATCHES;
+    int holdout = TUNE_HOLDOUT;
+    double floor = TUNE_FLOOR;
+    int jobs = match_pool_cores();
+    unsigned seed = 1;
+    const char *build = "bin/arena_sim";
+    const char *out = PARAMS_FILE;
+    int opt;
+    while ((opt = getopt(argc, argv, "g:l:n:H:f:j:s:b:o:")) != -1) {
+        switch (opt) {
+        case 'g':
+            generations = atoi(optarg);
+            break;
+        case 'l':
+            lambda = atoi(optarg);
+            break;
+        case 'n':
+            matches = atoi(optarg);
+            break;
+        case 'H':
+            holdout = atoi(optarg);
+            break;
+        case 'f':
+            floor = atof(optarg);
+            break;
+        case 'j':
+            jobs = atoi(optarg);
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'b':
+            build = optarg;
+            break;
+        case 'o':
+            out = optarg;
+            break;
+        default:
+            fprintf(stderr,
+                    "Usage: %s [-g generations] [-l candidates] "
+                    "[-n matches] [-H holdout] [-f floor] [-j jobs] "
+                    "[-s seed] [-b build] [-o params.txt]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if ((generations < 0) || (lambda < 2) || (matches < 1) ||
+        (holdout < 1) || (jobs < 1)) {
+        fprintf(stderr, "%s: nothing to do\n", argv[0]);
+        return 2;
+    }
+
+    for (int i = 0; i < params_count(); i++) {
+        if (params_desc(i)->min < params_desc(i)->max) {
+            dims[dim_count++] = i;
+        }
+    }
+    char dir[] = "/tmp/tune.XXXXXX";
+    CANDIDATE *c = calloc(lambda + 1, sizeof(CANDIDATE));
+    CANDIDATE *means = calloc(generations + 1, sizeof(CANDIDATE));
+    if (!mkdtemp(dir) || !c || !means) {
+        perror("tune");
+        return 2;
+    }
+    rng = seed;
+
+    // Start from the values tuned by hand
+    PARAMS p;
+    params_default(&p);
+    CANDIDATE best = {0};
+    from_params(&p, &best);
+    int means_count = 0;
+    double mean[sizeof(best.x) / sizeof(best.x[0])];
+    double step[sizeof(best.x) / sizeof(best.x[0])];
+    memcpy(mean, best.x, sizeof(mean));
+    for (int d = 0; d < dim_count; d++) {
+        step[d] = TUNE_STEP;
+    }
+    // Weights of the mu best candidates
+    int mu = lambda / 2;
+    double *weight = calloc(mu, sizeof(double));
+    double weight_sum = 0;
+    if (!weight) {
+        perror("tune");
+        return 2;
+    }
+    for (int k = 0; k < mu; k++) {
+        weight[k] = log(mu + 0.5) - log(k + 1);
+        weight_sum += weight[k];
+    }
+
+    int status = 0;
+    for (int g = 0; g < generations; g++) {
+        // New matches every generation, the mean is played on them too
+        unsigned match_seed = seed + g * matches;
+        memcpy(c[0].x, mean, sizeof(mean));
+        for (int i = 1; i <= lambda; i++) {
+            for (int d = 0; d < dim_count; d++) {
+                double x = mean[d] + step[d] * normal();
+                c[i].x[d] = fmax(0, fmin(1, x));
+            }
+        }
+        if (evaluate(c, lambda + 1, dir, build, matches, match_seed, floor,
+                     jobs)) {
+            fprintf(stderr, "tune: could not play the matches\n");
+            status = 2;
+            break;
+        }
+        CANDIDATE current = c[0];
+        means[means_count++] = current; // Only the means, the others are noisy
+        qsort(c + 1, lambda, sizeof(CANDIDATE), compare_cost);
+        printf("generation %2d: mean %.1f %% %.2f s, best %.1f %% %.2f s\n",
+               g, 100 * current.success, current.mean_s,
+               100 * c[1].success, c[1].mean_s);
+        fflush(stdout);
+
+        for (int d = 0; d < dim_count; d++) {
+            double m = 0;
+            double var = 0;
+            for (int k = 0; k < mu; k++) {
+                double x = c[1 + k].x[d];
+                m += weight[k] * x / weight_sum;
+                var += weight[k] * (x - mean[d]) * (x - mean[d]) / weight_sum;
+            }
+            mean[d] = m;
+            step[d] = fmax(TUNE_STEP_MIN,
+                           sqrt((1 - TUNE_LEARN) * step[d] * step[d] +
+                                TUNE_LEARN * var));
+        }
+    }
+
+    if (!status) {
+        // The last mean was not played yet
+        memcpy(means[means_count++].x, mean, sizeof(mean));
+        unsigned holdout_seed = seed + generations * matches;
+        if (evaluate(means, means_count, dir, build, holdout, holdout_seed,
+                     floor, jobs)) {
+            fprintf(stderr, "tune: could not play the holdout matches\n");
+            status = 2;
+        }
+    }
+    for (int i = 0; !status && (i < means_count); i++) {
+        printf("holdout mean %2d: %.1f %% %.2f s\n", i,
+               100 * means[i].success, means[i].mean_s);
+        if ((i == 0) || (means[i].cost < best.cost)) {
+            best = means[i];
+        }
+    }
+    rmdir(dir);
+    free(weight);
+    free(means);
+    free(c);
+    if (status) {
+        return status;
+    }
+
+    to_params(&best, &p);
+    FILE *f = fopen(out, "w");
+    if (!f) {
+        perror(out);
+        return 2;
+    }
+    fprintf(f, "# %.1f %% success, %.2f s to the base (%d holdout matches)\n",
+            100 * best.success, best.mean_s, holdout);
+    params_write(&p, f);
+    fclose(f);
+    printf("Parameters written in %s\n", out);
+    return 0;
+}